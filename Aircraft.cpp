@@ -31,9 +31,11 @@
 
 #include "Aircraft.h"
 
-Aircraft::Aircraft(uint32_t addr) {
-    this->addr = addr;
+Aircraft::Aircraft() {
+    messageRate = 0;
+    hidden = 0;
     prev_seen = 0;
+    prev_seenLatLon = 0;
 
     x = 0;
     y = 0;
@@ -46,9 +48,6 @@ Aircraft::Aircraft(uint32_t addr) {
     doy  = 0;
     ddox = 0;
     ddoy = 0;
-
-    lon = 0;
-    lat = 0;
 }
 
 
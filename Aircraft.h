@@ -31,41 +31,41 @@
 
 #include <stdint.h>
 
+#include "dump1090.h" //for struct aircraft
+
 #include <ctime>
 #include <vector> 
 #include <chrono>
 
+//
+// One point of an aircraft's trail
+//
+struct TrailPoint {
+    float lon, lat, heading;
+};
+
+//
+// Display side of an aircraft. The decoded state (address, callsign,
+// position, altitude...) lives in the decoder's struct aircraft and struct
+// aircraftCold of the same handle; this record sits next to them in the
+// aircraft store and only holds what the display adds: history, animation
+// timestamps and label layout.
+//
 class Aircraft {
 public:	
-    uint32_t        addr;           // ICAO address
-    char            flight[16];     // Flight number
-    unsigned char   signalLevel[8]; // Last 8 Signal Amplitudes
-    double          messageRate;
-    int             altitude;       // Altitude
-    int             speed;          // Velocity
-    int             track;          // Angle of flight
-    int             vert_rate;      // Vertical rate.
-    time_t          seen;           // Time at which the last packet was received
-    time_t          seenLatLon;           // Time at which the last packet was received
-    time_t          prev_seen;
-    double          lat, lon;       // Coordinated obtained from CPR encoded data
+    float           messageRate;
+    int             hidden;         // Mode A/C record matched to a Mode S aircraft
+    time_t          prev_seen;      // seen at the last update
+    time_t          prev_seenLatLon;// seenLatLon at the last update
+
     
     //history
 
-    std::vector <float>   lonHistory, latHistory, headingHistory;
-    std::vector <std::chrono::high_resolution_clock::time_point> timestampHistory;
+    std::vector <TrailPoint> trail;
 
-    // float           oldLon[TRAIL_LENGTH];
-    // float           oldLat[TRAIL_LENGTH];
-    // float           oldHeading[TRAIL_LENGTH];
-    // time_t          oldSeen[TRAIL_LENGTH];
-    // uint8_t         oldIdx; 
     std::chrono::high_resolution_clock::time_point        created;
     std::chrono::high_resolution_clock::time_point        msSeen;
     std::chrono::high_resolution_clock::time_point        msSeenLatLon;
-    int             live;
-
-    struct Aircraft *next;        // Next aircraft in our linked list
 
 //// label stuff -> should go to aircraft icon  class
 
@@ -75,6 +75,6 @@ public:
 
 /// methods
 
-    Aircraft(uint32_t addr);  
+    Aircraft();  
     ~Aircraft();
 };
\ No newline at end of file
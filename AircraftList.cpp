@@ -29,121 +29,142 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
+
 #include "AircraftList.h"
 
+#include <new>
+
 static std::chrono::high_resolution_clock::time_point now() {
     return std::chrono::high_resolution_clock::now();
 }
 
 
-Aircraft *AircraftList::find(uint32_t addr) {
-    Aircraft *p = head;
+//
+// Have the decoder keep an Aircraft next to each struct aircraft in its store
+// and tell us when it adds or frees one, so each gets exactly one display
+// record for its lifetime. Must be called before the first aircraft arrives.
+//
+void AircraftList::attach(Modes *modes) {
+    store = &modes->aircraftStore;
+    store->displaySize = (sizeof(Aircraft) + alignof(Aircraft) - 1) & ~(alignof(Aircraft) - 1);
 
-    while(p) {
-        if (p->addr == addr) return (p);
-        p = p->next;
-    }
-    return (nullptr);
+    modes->aircraftCreated = created;
+    modes->aircraftRemoved = removed;
+    modes->aircraftHookCtx = this;
 }
-    
-	//instead of this, net_io should call this class directly to update info
-void AircraftList::update(Modes *modes) {
-    struct aircraft *a = modes->aircrafts;
 
-    Aircraft *p = head;
+void AircraftList::created(void *ctx, int handle) {
+    AircraftList *list = (AircraftList *) ctx;
 
-    while(p) {
-        p->live = 0;
-        p = p->next;
-    }
+    new (list->display(handle)) Aircraft();
+    list->changed = 1;
+}
 
-    while(a) {
+void AircraftList::removed(void *ctx, int handle) {
+    AircraftList *list = (AircraftList *) ctx;
 
-        p = find(a->addr);
-        if (!p) {
-            p = new Aircraft(a->addr);
-            p->next = head;       
-            head = p;      
-        } else {
-            p->prev_seen = p->seen;
-        }
+    if(list->selected == handle) {
+        list->selected = AIRCRAFT_NONE;
+    }
+    if(list->commBAircraft == handle) {
+        list->commBAircraft = AIRCRAFT_NONE;
+    }
 
-        p->live = 1;
+    list->display(handle)->~Aircraft();
+    list->changed = 1;
+}
 
-        if(p->seen == a->seen) {
-            a = a->next;
-            continue;
-        }
+//
+// Nothing is copied from the decoder, this only notices what changed since
+// the last frame to keep the history and animation timestamps, and hides
+// Mode A/C records that duplicate a Mode S aircraft.
+//
+void AircraftList::update(Modes *modes) {
+    // Comm-B inference is only worth doing for the aircraft being looked at
+    if(selected == AIRCRAFT_NONE) {
+        commBAircraft = AIRCRAFT_NONE;
+        selectedCommB.valid = 0;
+    } else if(selected != commBAircraft || cold(selected)->commBCount != commBCount) {
+        decodeCommB(hot(selected), cold(selected), &selectedCommB);
+        commBAircraft = selected;
+        commBCount = cold(selected)->commBCount;
+        changed = 1;
+    }
 
-        p->seen = a->seen;            
-        p->msSeen = now();
+    // So is walking its chain in the DF log
+    if(selected == AIRCRAFT_NONE) {
+        selectedDFCount = 0;
+        dfSeq = 0;
+    } else {
+        int n = interactiveFindDF(modes, selected, selectedDF, SELECTED_DF_COUNT);
+        uint64_t seq = n ? selectedDF[0].seq : 0;
 
-        if((p->seen - p->prev_seen) > 0) {
-                p->messageRate = 1.0 / (double)(p->seen - p->prev_seen);
+        if(n != selectedDFCount || seq != dfSeq) {
+            changed = 1;
         }
+        selectedDFCount = n;
+        dfSeq = seq;
+    }
 
-        memcpy(p->flight, a->flight, sizeof(p->flight));
-        memcpy(p->signalLevel, a->signalLevel, sizeof(p->signalLevel));
+    for(int i = 0; i < count(); i++) {
+        int h = handle(i);
+        struct aircraft *a = hot(h);
+        Aircraft *p = display(h);
 
+        // Mode A/C records that matched a known Mode S aircraft are the same
+        // airframe, so don't show them twice
+        int hidden = (a->modeACflags & MODEAC_MSG_MODES_HIT) ? 1 : 0;
 
-        if(p->seenLatLon == a->seenLatLon) {
-            a = a->next;
-            continue;
+        if(p->hidden != hidden) {
+            p->hidden = hidden;
+            changed = 1;
+            if(hidden && selected == h) {
+                selected = AIRCRAFT_NONE;
+            }
         }
 
-        p->msSeenLatLon = now();
-
-        p->seenLatLon = a->seenLatLon;
+        if(hidden || p->prev_seen == a->seen) {
+            continue;
+        }
 
-        p->altitude = a->altitude;
-        p->speed =  a->speed;          
-        p->track = a->track;                  
+        if((a->seen - p->prev_seen) > 0) {
+            p->messageRate = 1.0f / (float)(a->seen - p->prev_seen);
+        }
+        p->prev_seen = a->seen;
+        p->msSeen = now();
+        changed = 1;
 
-        p->vert_rate = a->vert_rate;    
+        if(p->prev_seenLatLon == a->seenLatLon) {
+            continue;
+        }
 
-        if(p->lon == 0) {
+        if(p->prev_seenLatLon == 0) {
             p->created = now();
         }
-        p->lon = a->lon;
-        p->lat = a->lat;
-
-        p->lonHistory.push_back(p->lon);
-        p->latHistory.push_back(p->lat);
-        p->headingHistory.push_back(p->track);
-        p->timestampHistory.push_back(p->msSeenLatLon);
-        
-        a = a->next;
-    }
 
-    p = head;
-    Aircraft *prev = nullptr;
-
-    while(p) {
-        if(!p->live) {
-            if (!prev) {
-                head = p->next; 
-                delete(p); 
-                p = head; 
-            } else {
-                prev->next = p->next; 
-                delete(p); 
-                p = prev->next;
-            }
-        } else {
-            prev = p;
-            p = p->next;
-        }
+        p->prev_seenLatLon = a->seenLatLon;
+        p->msSeenLatLon = now();
+
+        TrailPoint point = {(float) a->lon, (float) a->lat, (float) a->track};
+        p->trail.push_back(point);
     }
 }
 
 AircraftList::AircraftList() {
-    head = nullptr;
+    store = nullptr;
+    selected = AIRCRAFT_NONE;
+    changed = 0;
+
+    memset(&selectedCommB, 0, sizeof(selectedCommB));
+    commBAircraft = AIRCRAFT_NONE;
+    commBCount = 0;
+
+    selectedDFCount = 0;
+    dfSeq = 0;
 }
 
 AircraftList::~AircraftList() {
-    while(head != nullptr) {
-        Aircraft *temp = head;
-        head  = head->next;
-        delete(temp);
+    for(int i = 0; i < count(); i++) {
+        display(handle(i))->~Aircraft();
     }
 }
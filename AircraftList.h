@@ -33,13 +33,48 @@
 
 #include "dump1090.h" //for Modes
 
+#define SELECTED_DF_COUNT 4		// Logged DF's shown for the selected aircraft
+
+//
+// The display's view of the decoder's aircraft store. Aircraft are handles,
+// with their decoder and display records reached through hot(), cold() and
+// display(); handles go stale when removed() is called for them.
+//
 class AircraftList {
 	public:
-		Aircraft *head;
+		int selected;				// Handle of the selected aircraft, AIRCRAFT_NONE if none
+
+		int changed;				// Something to redraw since the last update(), see AppData::update()
+
+		// Comm-B registers of the selected aircraft, decoded on demand
+		struct commB selectedCommB;
+
+		// Latest DF's of the selected aircraft, newest first, with --dflog
+		struct stDF selectedDF[SELECTED_DF_COUNT];
+		int selectedDFCount;
+
+		// Live aircraft, including hidden ones: handle(i) for i < count()
+		int count() const { return store ? (int) store->pool.live : 0; }
+		int handle(int i) const { return store->live[i]; }
+
+		struct aircraft *hot(int h) const { return aircraftHot(store, h); }
+		struct aircraftCold *cold(int h) const { return aircraftCold(store, h); }
+		Aircraft *display(int h) const { return (Aircraft *) aircraftDisplay(store, h); }
 
-		Aircraft *find(uint32_t addr);
 		void update(Modes *modes);
+		void attach(Modes *modes);
+
+		// struct aircraft lifetime hooks, see attach()
+		static void created(void *ctx, int handle);
+		static void removed(void *ctx, int handle);
 
 		AircraftList();
 		~AircraftList();
+
+	private:
+		struct aircraftStore *store;
+
+		int commBAircraft;			// Aircraft selectedCommB was decoded for
+		unsigned int commBCount;	// and its Comm-B reply count at the time
+		uint64_t dfSeq;				// Sequence number + 1 of selectedDF[0]
 };
@@ -30,6 +30,7 @@
 //
 
 #include "AppData.h"
+#include "Profiler.h"
 
 #include <cstdio>
 
@@ -60,10 +61,34 @@ void AppData::initialize() {
     }
     memset(modes.icao_cache, 0,   sizeof(uint32_t) * MODES_ICAO_CACHE_LEN * 2);
     modesInitErrorInfo(&(modes));
+    modesUpdateClock(&modes);
+    interactiveInit(&modes);
+    aircraftList.attach(&modes);
+
+    if (modes.filename) {
+        modesInitDemod(&modes);
+    }
 }
 
 
 void AppData::connect() {
+    if (modes.filename) {
+        if (!strcmp(modes.filename, "-")) {
+            modes.fd = STDIN_FILENO;
+        } else if ((modes.fd = open(modes.filename,
+#ifdef _WIN32
+                                    (O_RDONLY | O_BINARY)
+#else
+                                    (O_RDONLY)
+#endif
+                                    )) == -1) {
+            perror("Opening data file");
+            exit(1);
+        }
+        fd = ANET_ERR;
+        return;
+    }
+
     c = (struct client *) malloc(sizeof(*c));
     while(1) {
         if ((fd = setupConnection(c)) == ANET_ERR) {
@@ -80,29 +105,169 @@ void AppData::connect() {
 void AppData::disconnect() {
     if (fd != ANET_ERR) 
       {close(fd);}
+    if (modes.filename && modes.fd > STDIN_FILENO)
+      {close(modes.fd);}
 }
 
 
-void AppData::update() {
-    // if ((fd == ANET_ERR) || (recv(c->fd, pk_buf, sizeof(pk_buf), MSG_PEEK | MSG_DONTWAIT) == 0)) {
-    if ((fd == ANET_ERR) || (recv(c->fd, pk_buf, sizeof(pk_buf), MSG_PEEK ) == 0)) {
-        free(c);
-        usleep(1000000);
-        c = (struct client *) malloc(sizeof(*c));
-        fd = setupConnection(c);
+//
+// Read and demodulate one block of the --ifile recording. Returns without
+// doing anything once the file is exhausted.
+//
+void AppData::readFileBlock() {
+    unsigned char *p = (unsigned char *) modes.pFileData;
+    ssize_t toread = MODES_ASYNC_BUF_SIZE;
+
+    if (modes.exit) {
         return;
     }
-    char empty;
-    modesReadFromClient(&modes, c, &empty,decodeBinMessage);
+
+    while (toread) {
+        ssize_t nread = read(modes.fd, p, toread);
+        if (nread <= 0) {
+            modes.exit = 1; // Done reading, stop after this block
+            break;
+        }
+        p      += nread;
+        toread -= nread;
+    }
+
+    if (toread == MODES_ASYNC_BUF_SIZE) {
+        return;
+    }
+
+    if (toread) {
+        // Pad a short last block with zero-level I/Q samples
+        memset(p, 127, toread);
+    }
+
+    ProfileScope scope(PROFILE_DECODE);
+
+    computeMagnitudeVector(&modes, modes.pFileData);
+    detectModeS(&modes, modes.magnitude, MODES_ASYNC_BUF_SAMPLES);
+
+    modes.timestampBlk += (MODES_ASYNC_BUF_SAMPLES * 6);
+    modes.stat_blocks_processed++;
+}
+
+
+//
+// --demod-bench: push the whole --ifile recording through the demodulator as
+// fast as possible and report the throughput.
+//
+void AppData::demodBench() {
+    uint64_t start, elapsed;
+    double   seconds;
+
+    modesUpdateClock(&modes);
+    start = modes.clock_mono_ns;
+
+    while (!modes.exit) {
+        readFileBlock();
+    }
+
+    modesUpdateClock(&modes);
+    elapsed = modes.clock_mono_ns - start;
+    seconds = elapsed / 1e9;
+
+    printf("%u blocks, %.3f s, %.2f Msamples/s\n",
+           modes.stat_blocks_processed, seconds,
+           seconds > 0 ? (modes.stat_blocks_processed * (double) MODES_ASYNC_BUF_SAMPLES) / seconds / 1e6 : 0.0);
+    printf("%u valid preambles, %u good CRC, %u bad CRC, %u fixed\n",
+           modes.stat_valid_preamble, modes.stat_goodcrc, modes.stat_badcrc, modes.stat_fixed);
+    if (modes.phase_enhance) {
+        printf("%u out of phase, %u good CRC, %u bad CRC, %u fixed\n",
+               modes.stat_out_of_phase, modes.stat_ph_goodcrc, modes.stat_ph_badcrc, modes.stat_ph_fixed);
+    }
+    printf("%u %s records live, %u free, %u high water (%u slabs)\n", modes.aircraftStore.pool.live, modes.aircraftStore.pool.name,
+           modes.aircraftStore.pool.free, modes.aircraftStore.pool.highWater, modes.aircraftStore.pool.slabCount);
+}
+
+
+//
+// decodeBinMessage timed as the decode stage, nested inside ingest
+//
+static int profiledDecodeBinMessage(Modes *modes, struct client *c, char *p) {
+    ProfileScope scope(PROFILE_DECODE);
+    return decodeBinMessage(modes, c, p);
+}
+
+//
+// Read whatever has arrived, expire old aircraft and bring the display list
+// up to date. Returns nonzero if there is anything new to draw.
+//
+int AppData::update() {
+    if (modes.filename) {
+        // Play the recording back at roughly real time: one block of
+        // MODES_ASYNC_BUF_SAMPLES at 2 Msps is 64 ms of signal
+        modesUpdateClock(&modes);
+        if (modes.clock_mono_ms - lastFileBlock >= 64) {
+            lastFileBlock = modes.clock_mono_ms;
+
+            ProfileScope scope(PROFILE_INGEST);
+            readFileBlock();
+        }
+    } else {
+        // if ((fd == ANET_ERR) || (recv(c->fd, pk_buf, sizeof(pk_buf), MSG_PEEK | MSG_DONTWAIT) == 0)) {
+        if ((fd == ANET_ERR) || (recv(c->fd, pk_buf, sizeof(pk_buf), MSG_PEEK ) == 0)) {
+            free(c);
+            usleep(1000000);
+            c = (struct client *) malloc(sizeof(*c));
+            fd = setupConnection(c);
+            return 0;
+        }
+        // One clock sample for everything read and expired in this batch
+        modesUpdateClock(&modes);
+
+        ProfileScope scope(PROFILE_INGEST);
+
+        char empty;
+        modesReadFromClient(&modes, c, &empty, profiledDecodeBinMessage);
+    }
 
     interactiveRemoveStaleAircrafts(&modes);
 
     aircraftList.update(&modes);
 
+    if (!aircraftList.changed) {
+        return 0;
+    }
+    aircraftList.changed = 0;
+
     //this can probably be collapsed into somethingelse, came from status.c
     updateStatus();
+
+    return 1;
 }
 
+//
+// How long update() can be left alone, in ms, when nothing wakes us up
+// sooner: until the next block of a recording is due, otherwise until the
+// once a second expiry of stale aircraft.
+//
+int AppData::ingestTimeout() {
+    if (modes.filename) {
+        if (modes.exit) {
+            return 1000;
+        }
+
+        modesUpdateClock(&modes);
+        int wait = 64 - (int) (modes.clock_mono_ms - lastFileBlock);
+        return (wait > 0) ? wait : 0;
+    }
+
+    return 1000;
+}
+
+//
+// Socket to watch for incoming messages, or -1 if there's nothing to watch
+//
+int AppData::ingestFd() {
+    if (modes.filename || fd == ANET_ERR) {
+        return -1;
+    }
+    return fd;
+}
 
 void AppData::updateStatus() {
     // struct aircraft *a = Modes.aircrafts;
@@ -115,24 +280,28 @@ void AppData::updateStatus() {
     msgRateAccumulate = 0.0;    
 
 
-     Aircraft *p = aircraftList.head;
+     for (int i = 0; i < aircraftList.count(); i++) {
+         int h = aircraftList.handle(i);
+         struct aircraft *a = aircraftList.hot(h);
+         Aircraft *p = aircraftList.display(h);
+
+         if (p->hidden) {
+                 continue;
+         }
 
-     while(p) {
-         unsigned char * pSig       = p->signalLevel;
+         unsigned char * pSig       = a->signalLevel;
          unsigned int signalAverage = (pSig[0] + pSig[1] + pSig[2] + pSig[3] + 
                                        pSig[4] + pSig[5] + pSig[6] + pSig[7]);   
 
          sigAccumulate += signalAverage;
         
-         if (p->lon && p->lat) {
+         if (a->lon && a->lat) {
                  numVisiblePlanes++;
          }    
 
          totalCount++;
 
          msgRateAccumulate += p->messageRate; 
-
-         p = p->next;
      }
 
      msgRate                = msgRateAccumulate;
@@ -152,9 +321,14 @@ AppData::AppData(){
     modes.interactive_rows        = MODES_INTERACTIVE_ROWS;
     modes.interactive_delete_ttl  = MODES_INTERACTIVE_DELETE_TTL;
     modes.interactive_display_ttl = MODES_INTERACTIVE_DISPLAY_TTL;
+    modes.interactive_fade_ttl    = MODES_INTERACTIVE_FADE_TTL;
     modes.fUserLat                = MODES_USER_LATITUDE_DFLT;
     modes.fUserLon                = MODES_USER_LONGITUDE_DFLT;
 
     modes.interactive             = 0;
     modes.quiet                   = 1;
+    modes.mode_ac                 = 1;
+
+    benchDemod                    = 0;
+    lastFileBlock                 = 0;
 }
@@ -47,19 +47,25 @@ class AppData {
 	    struct client *c;
 	    int fd;
         char pk_buf[8];
+        uint64_t lastFileBlock;
 
 	public:
 		void initialize();
 		void connect();
 		void disconnect();
-		void update();
+		int update();
+		int ingestTimeout();
+		int ingestFd();
 		void updateStatus();
+		void readFileBlock();
+		void demodBench();
 		AppData();
 
 		AircraftList aircraftList;
 		Modes modes;
 
 		char server[32];
+		int benchDemod;
 
 	    int numVisiblePlanes;
 	    int numPlanes;
@@ -0,0 +1,141 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "GeometryBatch.h"
+
+#include "SDL2/SDL2_gfxPrimitives.h"
+
+#include <cmath>
+
+GeometryBatch::GeometryBatch(SDL_BlendMode blendMode) {
+    this->blendMode = blendMode;
+
+    calls = 0;
+    triangles = 0;
+}
+
+int GeometryBatch::vertex(float x, float y, SDL_Color color) {
+    BatchVertex v;
+
+    v.position.x = x;
+    v.position.y = y;
+    v.color = color;
+    v.tex_coord.x = 0;
+    v.tex_coord.y = 0;
+
+    vertices.push_back(v);
+
+    return vertices.size() - 1;
+}
+
+void GeometryBatch::triangle(float x1, float y1, float x2, float y2, float x3, float y3, SDL_Color color) {
+    indices.push_back(vertex(x1, y1, color));
+    indices.push_back(vertex(x2, y2, color));
+    indices.push_back(vertex(x3, y3, color));
+}
+
+//
+// Line of the given width, as a quad around the centre line
+//
+void GeometryBatch::line(float x1, float y1, float x2, float y2, float width, SDL_Color color) {
+    float dx = x2 - x1;
+    float dy = y2 - y1;
+    float len = sqrt(dx * dx + dy * dy);
+
+    if(len == 0) {
+        return;
+    }
+
+    float nx = -dy / len * width * 0.5f;
+    float ny = dx / len * width * 0.5f;
+
+    int a = vertex(x1 + nx, y1 + ny, color);
+    int b = vertex(x1 - nx, y1 - ny, color);
+    int c = vertex(x2 - nx, y2 - ny, color);
+    int d = vertex(x2 + nx, y2 + ny, color);
+
+    indices.push_back(a);
+    indices.push_back(b);
+    indices.push_back(c);
+    indices.push_back(a);
+    indices.push_back(c);
+    indices.push_back(d);
+}
+
+void GeometryBatch::disc(float x, float y, float radius, SDL_Color color) {
+    int centre = vertex(x, y, color);
+    int first = vertex(x + radius, y, color);
+
+    for(int i = 1; i <= BATCH_DISC_SEGMENTS; i++) {
+        float theta = 2.0f * M_PI * i / BATCH_DISC_SEGMENTS;
+
+        indices.push_back(centre);
+        indices.push_back(vertices.size() - 1);
+        indices.push_back(i == BATCH_DISC_SEGMENTS ? first : vertex(x + radius * cos(theta), y + radius * sin(theta), color));
+    }
+}
+
+//
+// Draw everything collected so far to the current render target and empty
+// the batch
+//
+void GeometryBatch::flush(SDL_Renderer *renderer) {
+    if(indices.empty()) {
+        return;
+    }
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+    SDL_BlendMode previous;
+
+    SDL_GetRenderDrawBlendMode(renderer, &previous);
+    SDL_SetRenderDrawBlendMode(renderer, blendMode);
+    SDL_RenderGeometry(renderer, NULL, vertices.data(), vertices.size(), indices.data(), indices.size());
+    SDL_SetRenderDrawBlendMode(renderer, previous);
+
+    calls++;
+#else
+    for(size_t i = 0; i < indices.size(); i += 3) {
+        BatchVertex *a = &vertices[indices[i]];
+        BatchVertex *b = &vertices[indices[i + 1]];
+        BatchVertex *c = &vertices[indices[i + 2]];
+
+        filledTrigonRGBA(renderer, a->position.x, a->position.y, b->position.x, b->position.y, c->position.x, c->position.y,
+            a->color.r, a->color.g, a->color.b, blendMode == SDL_BLENDMODE_NONE ? SDL_ALPHA_OPAQUE : a->color.a);
+
+        calls++;
+    }
+#endif
+
+    triangles += indices.size() / 3;
+
+    vertices.clear();
+    indices.clear();
+}
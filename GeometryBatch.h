@@ -0,0 +1,79 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef GEOMETRYBATCH_H
+#define GEOMETRYBATCH_H
+
+#include "SDL2/SDL.h"
+
+#include <vector>
+
+#define BATCH_DISC_SEGMENTS 8 //triangles per filled circle
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+typedef SDL_Vertex BatchVertex;
+#else
+// SDL_Vertex only exists from 2.0.18, keep the same layout for the fallback
+typedef struct BatchVertex {
+    struct { float x, y; } position;
+    SDL_Color color;
+    struct { float x, y; } tex_coord;
+} BatchVertex;
+#endif
+
+//
+// Untextured triangles collected over a frame and handed to the renderer in
+// one SDL_RenderGeometry call per flush, with a single blend mode for the
+// whole batch. Builds against SDL older than 2.0.18 fall back to drawing the
+// triangles one by one with SDL2_gfx.
+//
+class GeometryBatch {
+	public:
+		unsigned int calls;			// renderer submissions, for the stats overlay
+		unsigned int triangles;
+
+		void triangle(float x1, float y1, float x2, float y2, float x3, float y3, SDL_Color color);
+		void line(float x1, float y1, float x2, float y2, float width, SDL_Color color);
+		void disc(float x, float y, float radius, SDL_Color color);
+		void flush(SDL_Renderer *renderer);
+
+		GeometryBatch(SDL_BlendMode blendMode);
+
+	private:
+		SDL_BlendMode blendMode;
+
+		std::vector<BatchVertex> vertices;
+		std::vector<int> indices;
+
+		int vertex(float x, float y, SDL_Color color);
+};
+
+#endif
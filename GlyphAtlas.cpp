@@ -0,0 +1,202 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "GlyphAtlas.h"
+
+#include <stdio.h>
+
+#define GLYPH_COLUMNS 16 //glyph cells per atlas row
+
+GlyphAtlas::GlyphAtlas() {
+    texture = NULL;
+    width = 0;
+    height = 0;
+
+    for(int i = 0; i < GLYPH_COUNT; i++) {
+        rect[i].x = rect[i].y = rect[i].w = rect[i].h = 0;
+        advance[i] = 0;
+    }
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    destroy();
+}
+
+//
+// Render each glyph, pack them into a grid of cells sized to the largest one
+// and upload the lot as one texture. Returns 0 if the font can't be drawn.
+//
+int GlyphAtlas::build(SDL_Renderer *renderer, TTF_Font *font) {
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface *glyphs[GLYPH_COUNT];
+    SDL_Surface *atlas;
+    int cellW = 0;
+    int cellH = 0;
+
+    destroy();
+
+    height = TTF_FontHeight(font);
+    width = 0;
+
+    for(int i = 0; i < GLYPH_COUNT; i++) {
+        int minx, maxx, miny, maxy;
+
+        if(TTF_GlyphMetrics(font, GLYPH_FIRST + i, &minx, &maxx, &miny, &maxy, &advance[i]) < 0) {
+            advance[i] = 0;
+        }
+
+        if(advance[i] > width) {
+            width = advance[i];
+        }
+
+        glyphs[i] = TTF_RenderGlyph_Blended(font, GLYPH_FIRST + i, white);
+
+        if(glyphs[i]) {
+            if(glyphs[i]->w > cellW) {
+                cellW = glyphs[i]->w;
+            }
+            if(glyphs[i]->h > cellH) {
+                cellH = glyphs[i]->h;
+            }
+        }
+    }
+
+    atlas = NULL;
+    if(cellW && cellH) {
+        atlas = SDL_CreateRGBSurfaceWithFormat(0, cellW * GLYPH_COLUMNS, cellH * ((GLYPH_COUNT + GLYPH_COLUMNS - 1) / GLYPH_COLUMNS), 32, SDL_PIXELFORMAT_RGBA32);
+    }
+
+    for(int i = 0; i < GLYPH_COUNT; i++) {
+        if(!glyphs[i]) {
+            continue;
+        }
+
+        if(atlas) {
+            rect[i].x = (i % GLYPH_COLUMNS) * cellW;
+            rect[i].y = (i / GLYPH_COLUMNS) * cellH;
+            rect[i].w = glyphs[i]->w;
+            rect[i].h = glyphs[i]->h;
+
+            SDL_Rect dest = rect[i];
+
+            // copy the alpha coverage as is rather than blending it onto nothing
+            SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyphs[i], NULL, atlas, &dest);
+        }
+
+        SDL_FreeSurface(glyphs[i]);
+    }
+
+    if(!atlas) {
+        fprintf(stderr, "Couldn't build glyph atlas: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    texture = SDL_CreateTextureFromSurface(renderer, atlas);
+    SDL_FreeSurface(atlas);
+
+    if(!texture) {
+        fprintf(stderr, "Couldn't create glyph atlas texture: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    return 1;
+}
+
+//
+// Free the texture. Has to happen before the renderer goes away.
+//
+void GlyphAtlas::destroy() {
+    if(texture) {
+        SDL_DestroyTexture(texture);
+        texture = NULL;
+    }
+}
+
+//
+// Glyph index of the next character in a UTF-8 string, stepping past it
+//
+int GlyphAtlas::glyph(const char **text) {
+    unsigned char c = (unsigned char) **text;
+
+    (*text)++;
+
+    if(c >= 0x80) {
+        while((**text & 0xC0) == 0x80) {
+            (*text)++;
+        }
+        return '?' - GLYPH_FIRST;
+    }
+
+    if(c < GLYPH_FIRST || c > GLYPH_LAST) {
+        return '?' - GLYPH_FIRST;
+    }
+
+    return c - GLYPH_FIRST;
+}
+
+int GlyphAtlas::measure(const char *text) {
+    int w = 0;
+
+    while(*text) {
+        w += advance[glyph(&text)];
+    }
+
+    return w;
+}
+
+//
+// Draw text with its top left corner at x,y and return its width
+//
+int GlyphAtlas::draw(SDL_Renderer *renderer, const char *text, int x, int y, SDL_Color color) {
+    int start = x;
+
+    if(!texture) {
+        return 0;
+    }
+
+    SDL_SetTextureColorMod(texture, color.r, color.g, color.b);
+
+    while(*text) {
+        int i = glyph(&text);
+
+        if(rect[i].w) {
+            SDL_Rect dest = {x, y, rect[i].w, rect[i].h};
+            SDL_RenderCopy(renderer, texture, &rect[i], &dest);
+        }
+
+        x += advance[i];
+    }
+
+    return x - start;
+}
@@ -0,0 +1,70 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include "SDL2/SDL.h"
+#include "SDL2/SDL_ttf.h"
+
+#define GLYPH_FIRST 32 //printable ASCII, anything else is drawn as '?'
+#define GLYPH_LAST  126
+#define GLYPH_COUNT (GLYPH_LAST - GLYPH_FIRST + 1)
+
+//
+// Every printable glyph of one font rendered once into a single texture,
+// along with its metrics. Text is drawn as a run of copies out of that
+// texture, tinted with the texture colour mod, so nothing is rasterized or
+// uploaded per string.
+//
+class GlyphAtlas {
+	public:
+		int width;		// widest glyph advance, for fixed width layout
+		int height;		// line height
+
+		int build(SDL_Renderer *renderer, TTF_Font *font);
+		void destroy();
+
+		int measure(const char *text);
+		int draw(SDL_Renderer *renderer, const char *text, int x, int y, SDL_Color color);
+
+		GlyphAtlas();
+		~GlyphAtlas();
+
+	private:
+		int glyph(const char **text);
+
+		SDL_Texture *texture;
+		SDL_Rect rect[GLYPH_COUNT];		// where each glyph sits in texture
+		int advance[GLYPH_COUNT];
+};
+
+#endif
@@ -31,6 +31,10 @@
 
 #include "Input.h"
 
+#ifndef _WIN32
+#include <sys/select.h>
+#endif
+
 static std::chrono::high_resolution_clock::time_point now() {
     return std::chrono::high_resolution_clock::now();
 }
@@ -53,17 +57,43 @@ void Input::getInput()
 		
 	while (SDL_PollEvent(&event))
 	{
+		if(event.type == ingestEvent) {
+			// handled by the appData.update() that follows
+			continue;
+		}
+
+		view->dirty = 1;
+
 		switch (event.type)
 		{
 			case SDL_QUIT:
-				exit(0);
+				quit = true;
+			break;
+
+			// the renderer lost every texture, the glyph atlases too
+			case SDL_RENDER_DEVICE_RESET:
+				view->buildGlyphs();
+				// fall through
+
+			// the renderer lost the contents of its target textures
+			case SDL_RENDER_TARGETS_RESET:
+				view->textCache.clear();
+				view->mapRedraw = 1;
 			break;
 			
 			case SDL_KEYDOWN:
 				switch (event.key.keysym.sym)
 				{
 					case SDLK_ESCAPE:
-						exit(0);
+						quit = true;
+					break;
+
+					case SDLK_p:
+						view->requestSnapshot();
+					break;
+
+					case SDLK_f:
+						view->showProfile = !view->showProfile;
 					break;
 
 					default:
@@ -159,15 +189,81 @@ void Input::getInput()
 	}
 }
 
-Input::Input(AppData *appData, View *view) {
-	this->view = view;
-	this->appData = appData;
+//
+// Sleep until there's an SDL event, an ingest wakeup or timeoutMs has passed
+//
+void Input::waitForInput(int timeoutMs) {
+	SDL_WaitEventTimeout(NULL, timeoutMs);
 }
 
+void Input::startIngestWakeup() {
+	ingestEvent = SDL_RegisterEvents(1);
+	ingestFd = appData->ingestFd();
+	ingestThread = std::thread(&Input::watchIngest, this);
+}
 
+//
+// Call after appData.update() has read from the socket, so the ingest thread
+// can watch for the next message
+//
+void Input::ingestHandled() {
+	ingestFd = appData->ingestFd();
+	ingestPending = false;
+}
 
+//
+// Ingest wakeup thread: wait for the Beast socket to become readable, then
+// post an event so a main loop sleeping in waitForInput() gets to read it.
+// Only one wakeup is outstanding at a time.
+//
+void Input::watchIngest() {
+	while(!ingestStop) {
+		int fd = ingestFd;
+
+		if(fd < 0 || ingestPending) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(INGEST_IDLE_MS));
+			continue;
+		}
+
+		fd_set readfds;
+		struct timeval timeout = {0, 250000};
 
+		FD_ZERO(&readfds);
+		FD_SET(fd, &readfds);
 
+		int ready = select(fd + 1, &readfds, NULL, NULL, &timeout);
 
+		if(ready > 0) {
+			SDL_Event event;
 
+			SDL_zero(event);
+			event.type = ingestEvent;
 
+			ingestPending = true;
+			SDL_PushEvent(&event);
+		} else if(ready < 0) {
+			// socket went away under us, wait for the reconnect
+			std::this_thread::sleep_for(std::chrono::milliseconds(INGEST_IDLE_MS));
+		}
+	}
+}
+
+Input::Input(AppData *appData, View *view) {
+	this->view = view;
+	this->appData = appData;
+
+	quit = false;
+
+	ingestFd = -1;
+	ingestPending = false;
+	ingestStop = false;
+	ingestEvent = (Uint32) -1;
+}
+
+Input::~Input() {
+	ingestStop = true;
+
+	if(ingestThread.joinable()) {
+		ingestThread.join();
+	}
+}
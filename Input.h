@@ -35,22 +35,41 @@
 #include "AppData.h"
 #include "View.h" 
 
+#include <atomic>
 #include <chrono>
+#include <thread>
+
+#define INGEST_IDLE_MS 10 //ingest thread nap while there's no socket or a wakeup is pending
 
 class Input {
 public:
 	void getInput();
+	void waitForInput(int timeoutMs);
+	void startIngestWakeup();
+	void ingestHandled();
 
 	//should input know about view?
 	Input(AppData *appData, View *view);
+	~Input();
 
 	View *view;
 	AppData *appData;
 
+	bool quit;		// window closed or Esc, the main loop should return
+
 	std::chrono::high_resolution_clock::time_point touchDownTime;
     int touchx;
     int touchy;
     int tapCount;
+
+private:
+	void watchIngest();
+
+	std::thread ingestThread;
+	std::atomic<int> ingestFd;			// socket the ingest thread watches, -1 for none
+	std::atomic<bool> ingestPending;	// wakeup posted and not yet handled
+	std::atomic<bool> ingestStop;
+	Uint32 ingestEvent;
 };
 
 #endif
\ No newline at end of file
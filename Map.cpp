@@ -32,221 +32,336 @@
 #include "Map.h"
 #include <stdio.h>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <utility>
 
-bool Map::QTInsert(QuadTree *tree, Line *line, int depth) {
+//
+// Zero coordinates separate the polylines in mapdata.bin
+//
+static bool isBreak(const Point &p) {
+  return p.lat == 0 || p.lon == 0;
+}
 
-  // if(depth > 25) {
-  //  // printf("fail [%f %f] -> [%f %f]\n",line->start.lon,line->start.lat,line->end.lon,line->end.lat);
+//
+// count lon, lat pairs from fileptr
+//
+static bool readPoints(FILE *fileptr, int count, std::vector<Point> &points) {
+  points.resize(count);
 
-  //  // printf("bounds %f %f %f %f\n",tree->lon_min, tree->lon_max, tree->lat_min, tree->lat_max);
-  //   // fflush(stdout); 
-  //    tree->lines.push_back(&(*line));
-  //    return true;
-  // }
-  
+  if(count && fread(points.data(), sizeof(Point), count, fileptr) != (size_t) count) {
+    return false;
+  }
 
-  bool startInside = line->start.lat >= tree->lat_min &&
-   line->start.lat <= tree->lat_max &&
-   line->start.lon >= tree->lon_min &&
-   line->start.lon <= tree->lon_max;
+  for(int i = 0; i < count; i++) {
+    std::swap(points[i].lat, points[i].lon);
+  }
 
-  bool endInside = line->end.lat >= tree->lat_min &&
-   line->end.lat <= tree->lat_max &&
-   line->end.lon >= tree->lon_min &&
-   line->end.lon <= tree->lon_max;
+  return true;
+}
 
-  // if (!startInside || !endInside) {
-  //   return false; 
-  // }
-  if (!startInside && !endInside) {
-    return false; 
+//
+// Smallest node under node holding the polyline's bounding box, creating
+// children on the way down
+//
+int MapLevel::nodeFor(int node, const Polyline &polyline, int depth) {
+  if(depth >= QUADTREE_MAX_DEPTH) {
+    return node;
   }
-  
-  if (startInside != endInside) {
-    tree->lines.push_back(&(*line));
-    return true; 
-  }     
 
-  if (tree->nw == NULL) {
-  	tree->nw = new QuadTree;
+  float lat_mid = nodes[node].lat_min + 0.5 * (nodes[node].lat_max - nodes[node].lat_min);
+  float lon_mid = nodes[node].lon_min + 0.5 * (nodes[node].lon_max - nodes[node].lon_min);
+
+  int quadrant = (polyline.lat_min >= lat_mid) * 2 + (polyline.lon_min >= lon_mid);
 
-  	tree->nw->lat_min = tree->lat_min;	
-  	tree->nw->lat_max = tree->lat_min + 0.5 * (tree->lat_max - tree->lat_min);
-  	tree->nw->lon_min = tree->lon_min;
-  	tree->nw->lon_max = tree->lon_min + 0.5 * (tree->lon_max - tree->lon_min);
+  if(quadrant != (polyline.lat_max >= lat_mid) * 2 + (polyline.lon_max >= lon_mid)) {
+    return node;
   }
 
-  if (QTInsert(tree->nw, line, depth++)){
-  	return true;
+  if(nodes[node].child[quadrant] < 0) {
+    const QuadNode &parent = nodes[node];
+
+    QuadNode child((quadrant & 2) ? lat_mid : parent.lat_min,
+                   (quadrant & 2) ? parent.lat_max : lat_mid,
+                   (quadrant & 1) ? lon_mid : parent.lon_min,
+                   (quadrant & 1) ? parent.lon_max : lon_mid);
+
+    // push_back can move parent, so index again after
+    nodes.push_back(child);
+    nodes[node].child[quadrant] = nodes.size() - 1;
   }
 
-  if (tree->sw == NULL) {
-  	tree->sw = new QuadTree;
+  return nodeFor(nodes[node].child[quadrant], polyline, depth + 1);
+}
+
+//
+// Polylines for points[first, first + count), split into runs of at most
+// POLYLINE_MAX_POINTS
+//
+void MapLevel::addPolyline(int first, int count) {
+  for(int start = 0; start < count - 1; start += POLYLINE_MAX_POINTS - 1) {
+    Polyline polyline;
+
+    polyline.first = first + start;
+    polyline.count = std::min(POLYLINE_MAX_POINTS, count - start);
+    polyline.lat_min = polyline.lon_min = 180.0f;
+    polyline.lat_max = polyline.lon_max = -180.0f;
+
+    for(int i = polyline.first; i < polyline.first + polyline.count; i++) {
+      polyline.lon_min = std::min(polyline.lon_min, points[i].lon);
+      polyline.lon_max = std::max(polyline.lon_max, points[i].lon);
+      polyline.lat_min = std::min(polyline.lat_min, points[i].lat);
+      polyline.lat_max = std::max(polyline.lat_max, points[i].lat);
+    }
 
-  	tree->sw->lat_min = tree->lat_min;	
-  	tree->sw->lat_max = tree->lat_min + 0.5 * (tree->lat_max - tree->lat_min);
-  	tree->sw->lon_min = tree->lon_min + 0.5 * (tree->lon_max - tree->lon_min);
-  	tree->sw->lon_max = tree->lon_max;
+    polylines.push_back(polyline);
   }
+}
 
-	if (QTInsert(tree->sw, line, depth++)){
-	 return true;
+//
+// Polylines and quadtree for points
+//
+void MapLevel::build() {
+  int count = points.size();
+
+  QuadNode root(180.0f, -180.0f, 180.0f, -180.0f);
+
+  for(int i = 0; i < count; i++) {
+    if(isBreak(points[i]))
+      continue;
+
+    root.lon_min = std::min(root.lon_min, points[i].lon);
+    root.lon_max = std::max(root.lon_max, points[i].lon);
+    root.lat_min = std::min(root.lat_min, points[i].lat);
+    root.lat_max = std::max(root.lat_max, points[i].lat);
   }
 
-  if (tree->ne == NULL) {
-  	tree->ne = new QuadTree;
+  polylines.clear();
+  nodes.clear();
+  nodes.push_back(root);
 
-  	tree->ne->lat_min = tree->lat_min + 0.5 * (tree->lat_max - tree->lat_min);	
-  	tree->ne->lat_max = tree->lat_max;
-  	tree->ne->lon_min = tree->lon_min;
-  	tree->ne->lon_max = tree->lon_min + 0.5 * (tree->lon_max - tree->lon_min);
-  } 
+  // runs of points between breaks
+  int start = -1;
+
+  for(int i = 0; i <= count; i++) {
+    if(i < count && !isBreak(points[i])) {
+      if(start < 0) {
+        start = i;
+      }
+      continue;
+    }
 
-  if (QTInsert(tree->ne, line, depth++)){
-  	return true;	
-  } 	
+    if(start >= 0) {
+      addPolyline(start, i - start);
+      start = -1;
+    }
+  }
 
-  if (tree->se == NULL) {  
-  	tree->se = new QuadTree;
+  // file each polyline, then lay them out node by node
+  std::vector<int> polylineNode(polylines.size());
 
-  	tree->se->lat_min = tree->lat_min + 0.5 * (tree->lat_max - tree->lat_min);
-  	tree->se->lat_max = tree->lat_max;
-  	tree->se->lon_min = tree->lon_min + 0.5 * (tree->lon_max - tree->lon_min);
-  	tree->se->lon_max = tree->lon_max;
-	}  
+  for(size_t i = 0; i < polylines.size(); i++) {
+    polylineNode[i] = nodeFor(0, polylines[i], 0);
+    nodes[polylineNode[i]].count++;
+  }
 
-  if (QTInsert(tree->se, line, depth++)){
-  	return true;	
-	} 
-	
-  tree->lines.push_back(&(*line));
+  int total = 0;
+  for(size_t n = 0; n < nodes.size(); n++) {
+    nodes[n].first = total;
+    total += nodes[n].count;
+    nodes[n].count = 0;
+  }
 
-  return true;
+  nodePolylines.resize(total);
+
+  for(size_t i = 0; i < polylines.size(); i++) {
+    QuadNode &node = nodes[polylineNode[i]];
+    nodePolylines[node.first + node.count++] = i;
+  }
+
+  nodes.shrink_to_fit();
+  polylines.shrink_to_fit();
 }
 
+//
+// Fallback for maps converted without levels: drop vertices closer than
+// tolerance to the last one kept, and polylines smaller than tolerance
+// altogether. Cruder than the converter's Douglas-Peucker but linear and
+// never off by more than tolerance.
+//
+void MapLevel::simplify(const MapLevel &finer, float tolerance) {
+  const std::vector<Point> &in = finer.points;
+  float limit = tolerance * tolerance;
+  size_t i = 0;
 
-std::vector<Line*> Map::getLinesRecursive(QuadTree *tree, float screen_lat_min, float screen_lat_max, float screen_lon_min, float screen_lon_max) {
-    std::vector<Line*> retLines;
+  this->tolerance = tolerance;
+  points.clear();
 
-    if(tree == NULL) {
-        return retLines;
+  while(i < in.size()) {
+    if(isBreak(in[i])) {
+      i++;
+      continue;
     }
 
-    if (tree->lat_min > screen_lat_max || screen_lat_min > tree->lat_max) {
-        return retLines; 
+    size_t end = i;
+    float lat_min = 180.0f, lat_max = -180.0f, lon_min = 180.0f, lon_max = -180.0f;
+
+    for(; end < in.size() && !isBreak(in[end]); end++) {
+      lat_min = std::min(lat_min, in[end].lat);
+      lat_max = std::max(lat_max, in[end].lat);
+      lon_min = std::min(lon_min, in[end].lon);
+      lon_max = std::max(lon_max, in[end].lon);
     }
 
-    if (tree->lon_min > screen_lon_max || screen_lon_min > tree->lon_max) {
-        return retLines; 
+    if(end - i > 1 && (lat_max - lat_min >= tolerance || lon_max - lon_min >= tolerance)) {
+      points.push_back(in[i]);
+
+      for(size_t j = i + 1; j < end - 1; j++) {
+        float dlat = in[j].lat - points.back().lat;
+        float dlon = in[j].lon - points.back().lon;
+
+        if(dlat * dlat + dlon * dlon >= limit) {
+          points.push_back(in[j]);
+        }
+      }
+
+      Point gap = {0, 0};
+
+      points.push_back(in[end - 1]);
+      points.push_back(gap);
     }
 
-    std::vector<Line*> ret;
-    ret = getLinesRecursive(tree->nw, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
-    retLines.insert(retLines.end(), ret.begin(), ret.end());
+    i = end;
+  }
 
-    ret = getLinesRecursive(tree->sw, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
-    retLines.insert(retLines.end(), ret.begin(), ret.end());
+  points.shrink_to_fit();
+}
+
+//
+// Coarser levels written by mapconverter.py: "VLOD", the base tolerance,
+// the point count of mapdata.bin it was made with, the level count, then
+// for each level its tolerance, point count and lon, lat pairs as in
+// mapdata.bin. Counts are checked against what's left of the file before
+// anything is allocated, so a truncated or corrupt file is just ignored.
+//
+bool Map::loadLevels(const char *filename) {
+  FILE *fileptr;
+  char magic[4];
+  float baseTolerance;
+  int basePoints;
+  int count;
+  long remaining;
+
+  if(!(fileptr = fopen(filename, "rb"))) {
+    return false;
+  }
 
-    ret = getLinesRecursive(tree->ne, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
-    retLines.insert(retLines.end(), ret.begin(), ret.end());
+  fseek(fileptr, 0, SEEK_END);
+  remaining = ftell(fileptr);
+  rewind(fileptr);
+
+  if(fread(magic, 1, 4, fileptr) != 4 || memcmp(magic, "VLOD", 4) ||
+    fread(&baseTolerance, sizeof(float), 1, fileptr) != 1 ||
+    fread(&basePoints, sizeof(int), 1, fileptr) != 1 ||
+    fread(&count, sizeof(int), 1, fileptr) != 1 || count < 0 || count > MAP_LOD_MAX_LEVELS) {
+    fprintf(stderr, "%s isn't a map level file\n", filename);
+    fclose(fileptr);
+    return false;
+  }
 
-    ret = getLinesRecursive(tree->se, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
-    retLines.insert(retLines.end(), ret.begin(), ret.end());
+  if(basePoints != (int) levels[0].points.size()) {
+    fprintf(stderr, "%s was made from a different mapdata.bin, ignoring it\n", filename);
+    fclose(fileptr);
+    return false;
+  }
 
-    retLines.insert(retLines.end(), tree->lines.begin(), tree->lines.end());   
+  remaining -= 4 + sizeof(float) + 2 * sizeof(int);
 
-    // Debug quadtree
-    // Point TL, TR, BL, BR;
+  levels.resize(count + 1);
+  levels[0].tolerance = baseTolerance;
 
-    // TL.lat = tree->lat_min;
-    // TL.lon = tree->lon_min;
+  for(int i = 1; i <= count; i++) {
+    int points = -1;
 
-    // TR.lat = tree->lat_max;
-    // TR.lon = tree->lon_min;
+    if(fread(&levels[i].tolerance, sizeof(float), 1, fileptr) == 1 &&
+      fread(&points, sizeof(int), 1, fileptr) == 1) {
+      remaining -= sizeof(float) + sizeof(int);
+    }
 
-    // BL.lat = tree->lat_min;
-    // BL.lon = tree->lon_max;
+    if(points < 0 || points > remaining / (long) sizeof(Point) ||
+      !readPoints(fileptr, points, levels[i].points)) {
+      fprintf(stderr, "Read error in %s\n", filename);
+      levels.resize(1);
+      levels[0].tolerance = MAP_LOD_TOLERANCE;
+      fclose(fileptr);
+      return false;
+    }
 
-    // BR.lat = tree->lat_max;
-    // BR.lon = tree->lon_max;
+    remaining -= points * sizeof(Point);
+  }
 
-    // retLines.push_back(new Line(TL,TR));
-    // retLines.push_back(new Line(TR,BR));
-    // retLines.push_back(new Line(BL,BR));
-    // retLines.push_back(new Line(TL,BL));
+  fclose(fileptr);
 
-    return retLines;
+  return true;
 }
 
-std::vector<Line*> Map::getLines(float screen_lat_min, float screen_lat_max, float screen_lon_min, float screen_lon_max) {
-  return getLinesRecursive(&root, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
-};
+//
+// Coarsest level still finer than a pixel
+//
+int Map::levelFor(float degreesPerPixel) const {
+  int level = 0;
+
+  for(size_t i = 1; i < levels.size(); i++) {
+    if(levels[i].tolerance <= degreesPerPixel) {
+      level = i;
+    }
+  }
+
+  return level;
+}
 
 Map::Map() { 
   FILE *fileptr;
 
   if(!(fileptr = fopen("mapdata.bin", "rb"))) {
-    printf("Couldn't read mapdata.bin\nDid you run getmap.sh?\n");
+    fprintf(stderr, "Couldn't read mapdata.bin\nDid you run getmap.sh?\n");
     exit(0);
   }  
 
   fseek(fileptr, 0, SEEK_END);
-  mapPoints_count = ftell(fileptr) / sizeof(float);
+  int count = ftell(fileptr) / sizeof(Point);
   rewind(fileptr);                   
 
-  mapPoints = (float *)malloc(mapPoints_count * sizeof(float)); 
-  if(!fread(mapPoints, sizeof(float), mapPoints_count, fileptr)){
-    printf("Read error\n");
+  levels.resize(1);
+  levels[0].tolerance = MAP_LOD_TOLERANCE;
+
+  if(!count || !readPoints(fileptr, count, levels[0].points)){
+    fprintf(stderr, "Read error\n");
     exit(0);
   } 
 
   fclose(fileptr);
 
-  printf("Read %d map points.\n",mapPoints_count / 2);
-
-  // load quad tree
+  fprintf(stderr, "Read %d map points.\n", count);
 
-	for(int i = 0; i < mapPoints_count; i+=2) {
-		if(mapPoints[i] == 0)
-			continue;
+  if(!loadLevels("mapdata-lod.bin")) {
+    levels.resize(MAP_LOD_LEVELS + 1);
 
-		if(mapPoints[i] < root.lon_min) {
-			root.lon_min = mapPoints[i];
-		} else if(mapPoints[i] > root.lon_max) {
-			root.lon_max = mapPoints[i];
-		} 
-
-		if(mapPoints[i+1] < root.lat_min) {
-			root.lat_min = mapPoints[i+1];
-		} else if(mapPoints[i+1] > root.lat_max) {
-			root.lat_max = mapPoints[i+1];
-		} 
-	}
-
-  printf("map bounds: %f %f %f %f\n",root.lon_min, root.lon_max, root.lat_min, root.lat_max);
-
-  Point currentPoint;
-  Point nextPoint;
+    for(int i = 1; i <= MAP_LOD_LEVELS; i++) {
+      levels[i].simplify(levels[0], levels[i - 1].tolerance * MAP_LOD_FACTOR);
+    }
+  }
 
-  for(int i = 0; i < mapPoints_count - 2; i+=2) {
-    if(mapPoints[i] == 0)
-      continue;
-    if(mapPoints[i + 1] == 0)
-      continue;
-    if(mapPoints[i + 2] == 0)
-      continue;
-    if(mapPoints[i + 3] == 0)
-      continue;
-    currentPoint.lon = mapPoints[i];
-    currentPoint.lat = mapPoints[i + 1];
+  // load quad trees
 
-    nextPoint.lon = mapPoints[i + 2];
-    nextPoint.lat = mapPoints[i + 3];
+  for(size_t i = 0; i < levels.size(); i++) {
+    levels[i].build();
 
-    // printf("inserting [%f %f] -> [%f %f]\n",currentPoint.lon,currentPoint.lat,nextPoint.lon,nextPoint.lat);
+    const QuadNode &root = levels[i].nodes[0];
 
-    QTInsert(&root, new Line(currentPoint, nextPoint), 0);
-	}
+    fprintf(stderr, "map level %d: tolerance %g, %d points, bounds: %f %f %f %f\n", (int) i, levels[i].tolerance,
+      (int) levels[i].points.size(), root.lon_min, root.lon_max, root.lat_min, root.lat_max);
+  }
 
-  printf("done\n");
+  fprintf(stderr, "done\n");
 }
@@ -32,89 +32,155 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <cstddef>
 #include <vector>
 
+#define LATLONMULT 111.195 // 6371.0 * M_PI / 180.0
+
 typedef struct Point{
 	float lat;
 	float lon;
 } Point;
 
-typedef struct Line{
+#define QUADTREE_MAX_DEPTH 24
+#define POLYLINE_MAX_POINTS 64		// longer polylines are split so culling stays tight
+
+//
+// Run of connected vertices in Map::points and its bounding box
+//
+typedef struct Polyline{
 	float lat_min;
-  	float lat_max;
-  	float lon_min;
-  	float lon_max;
+	float lat_max;
+	float lon_min;
+	float lon_max;
 
-	Point start;
-	Point end;
+	int first;
+	int count;
+} Polyline;
 
-	Line(Point start, Point end) {
-		this->start = start;
-		this->end = end;
+//
+// Quadtree node in Map::nodes. Children are indices into the same array,
+// -1 where there isn't one; a node's polylines are
+// nodePolylines[first, first + count).
+//
+typedef struct QuadNode{
+	float lat_min;
+	float lat_max;
+	float lon_min;
+	float lon_max;
+
+	int child[4];
+	int first;
+	int count;
+
+	QuadNode(float lat_min, float lat_max, float lon_min, float lon_max) {
+		this->lat_min = lat_min;
+		this->lat_max = lat_max;
+		this->lon_min = lon_min;
+		this->lon_max = lon_max;
+
+		for(int i = 0; i < 4; i++) {
+			child[i] = -1;
+		}
 
-		lat_min = std::min(start.lat,end.lat);
-		lat_max = std::max(start.lat,end.lat);
-		lon_min = std::min(start.lon,end.lon);
-		lon_max = std::max(start.lon,end.lon);
+		first = 0;
+		count = 0;
 	}
-} Line;
-
-typedef struct QuadTree{
-  	float lat_min;
-  	float lat_max;
-  	float lon_min;
-  	float lon_max;
-
-	std::vector<Line*> lines;
-
-	struct QuadTree *nw;
-	struct QuadTree *sw;
-	struct QuadTree *ne;
-	struct QuadTree *se;
-
-	QuadTree() {
-		lat_min = 180.0f;
-		lon_min = 180.0f;
-		lat_max = -180.0f;
-		lon_max = -180.0f;
-
-		nw = NULL;
-		sw = NULL;
-		ne = NULL;
-		se = NULL;
+} QuadNode;
+
+#define MAP_LOD_TOLERANCE 0.001f	// mapconverter.py's default, for maps without mapdata-lod.bin
+#define MAP_LOD_LEVELS 4			// coarser levels made when loading a map without them
+#define MAP_LOD_FACTOR 4.0f			// tolerance step between levels
+#define MAP_LOD_MAX_LEVELS 16		// most levels mapdata-lod.bin may hold
+
+//
+// One level of detail. Every vertex sits in one array, polylines separated
+// by a zero point as in mapdata.bin. Polylines are split into runs of at
+// most POLYLINE_MAX_POINTS, sharing the vertex at each split, and each run
+// is filed in the smallest quadtree node that holds its bounding box.
+//
+class MapLevel {
+
+public:
+	float tolerance;					// simplification, degrees
+	std::vector<Point> points;
+	std::vector<Polyline> polylines;
+	std::vector<QuadNode> nodes;		// nodes[0] is the root
+	std::vector<int> nodePolylines;		// polyline indices, grouped by node
+
+	void build();
+	void simplify(const MapLevel &finer, float tolerance);
+
+	//
+	// Calls visit(const Point *points, int count) for every polyline whose
+	// bounding box overlaps the box. Nothing is allocated, so it's safe to
+	// call per frame.
+	//
+	template <typename Visitor>
+	void forEachPolyline(float screen_lat_min, float screen_lat_max, float screen_lon_min, float screen_lon_max, Visitor &visit) const {
+		if(!nodes.empty()) {
+			forEachPolylineRecursive(0, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max, visit);
+		}
 	}
 
-	~QuadTree() {
-		if(nw != NULL) {
-			delete nw;
+private:
+	int nodeFor(int node, const Polyline &polyline, int depth);
+	void addPolyline(int first, int count);
+
+	template <typename Visitor>
+	void forEachPolylineRecursive(int index, float screen_lat_min, float screen_lat_max, float screen_lon_min, float screen_lon_max, Visitor &visit) const {
+		const QuadNode &node = nodes[index];
+
+		if (node.lat_min > screen_lat_max || screen_lat_min > node.lat_max) {
+			return;
 		}
 
-		if(sw != NULL) {
-			delete nw;
+		if (node.lon_min > screen_lon_max || screen_lon_min > node.lon_max) {
+			return;
 		}
 
-		if(ne != NULL) {
-			delete nw;
+		for(int i = 0; i < 4; i++) {
+			if(node.child[i] >= 0) {
+				forEachPolylineRecursive(node.child[i], screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max, visit);
+			}
 		}
 
-		if(ne != NULL) {
-			delete nw;
+		for(int i = node.first; i < node.first + node.count; i++) {
+			const Polyline &polyline = polylines[nodePolylines[i]];
+
+			if (polyline.lat_min > screen_lat_max || screen_lat_min > polyline.lat_max) {
+				continue;
+			}
+
+			if (polyline.lon_min > screen_lon_max || screen_lon_min > polyline.lon_max) {
+				continue;
+			}
+
+			visit(&points[polyline.first], polyline.count);
 		}
 	}
-} QuadTree;
+};
 
+//
+// Map pyramid. levels[0] is mapdata.bin as converted; coarser levels come
+// from mapdata-lod.bin if mapconverter.py wrote one, or are simplified from
+// level 0 on load.
+//
 class Map {
 
 public:
-	QuadTree root;
+	std::vector<MapLevel> levels;		// finest first
+
+	int levelFor(float degreesPerPixel) const;
 
-	bool QTInsert(QuadTree *tree, Line *line, int depth);
-	std::vector<Line*> getLinesRecursive(QuadTree *tree, float screen_lat_min, float screen_lat_max, float screen_lon_min, float screen_lon_max);
-	std::vector<Line*> getLines(float screen_lat_min, float screen_lat_max, float screen_lon_min, float screen_lon_max);
+	template <typename Visitor>
+	void forEachPolyline(int level, float screen_lat_min, float screen_lat_max, float screen_lon_min, float screen_lon_max, Visitor &visit) const {
+		levels[level].forEachPolyline(screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max, visit);
+	}
 
 	Map(); 
 
-	int mapPoints_count;
-	float *mapPoints;
+private:
+	bool loadLevels(const char *filename);
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "MapCache.h"
+
+size_t MapKeyHash::operator()(const MapKey &key) const {
+    size_t h = std::hash<int>()(key.level);
+
+    h ^= std::hash<int>()(key.cellX) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= std::hash<int>()(key.cellY) + 0x9e3779b9 + (h << 6) + (h >> 2);
+
+    return h;
+}
+
+MapCache::MapCache() {
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+
+    bytes = 0;
+    budget = MAP_CACHE_BYTES;
+}
+
+MapCache::~MapCache() {
+    clear();
+}
+
+//
+// Whether there's a raster for key, counting a hit or a miss
+//
+bool MapCache::contains(const MapKey &key) {
+    if(index.find(key) != index.end()) {
+        hits++;
+        return true;
+    }
+
+    misses++;
+    return false;
+}
+
+//
+// Mark a raster as just used so it's the last to go
+//
+void MapCache::touch(const MapKey &key) {
+    std::unordered_map<MapKey, EntryList::iterator, MapKeyHash>::iterator found = index.find(key);
+
+    if(found != index.end()) {
+        lru.splice(lru.begin(), lru, found->second);
+    }
+}
+
+//
+// Texture for a new raster. If adding it would go over budget the
+// least recently used raster is evicted and its texture reused. The most
+// recent one is always kept, it's probably on screen.
+//
+SDL_Texture *MapCache::take(SDL_Renderer *renderer, int w, int h) {
+    while(bytes + w * h * 4 > budget && lru.size() > 1) {
+        Entry oldest = lru.back();
+
+        index.erase(oldest.key);
+        lru.pop_back();
+        bytes -= oldest.w * oldest.h * 4;
+        evictions++;
+
+        if(oldest.w == w && oldest.h == h) {
+            return oldest.texture;
+        }
+
+        SDL_DestroyTexture(oldest.texture);
+    }
+
+    return SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, w, h);
+}
+
+//
+// Add a finished raster, the cache owns the texture from here on
+//
+void MapCache::insert(const MapKey &key, const MapRaster &raster, SDL_Texture *texture, int w, int h) {
+    std::unordered_map<MapKey, EntryList::iterator, MapKeyHash>::iterator found = index.find(key);
+
+    if(found != index.end()) {
+        bytes -= found->second->w * found->second->h * 4;
+        SDL_DestroyTexture(found->second->texture);
+        lru.erase(found->second);
+        index.erase(found);
+    }
+
+    Entry entry;
+
+    entry.key = key;
+    entry.raster = raster;
+    entry.texture = texture;
+    entry.w = w;
+    entry.h = h;
+
+    lru.push_front(entry);
+    index[key] = lru.begin();
+    bytes += w * h * 4;
+}
+
+//
+// Drop every raster, at shutdown or when the renderer has lost them
+//
+void MapCache::clear() {
+    for(EntryList::iterator it = lru.begin(); it != lru.end(); ++it) {
+        SDL_DestroyTexture(it->texture);
+    }
+
+    lru.clear();
+    index.clear();
+    bytes = 0;
+}
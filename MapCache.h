@@ -0,0 +1,111 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef MAPCACHE_H
+#define MAPCACHE_H
+
+#include "SDL2/SDL.h"
+
+#include <list>
+#include <unordered_map>
+
+#define MAP_CACHE_BYTES (64 * 1024 * 1024) //texture memory kept for map rasters
+
+//
+// The view a map texture was (or is being) rasterized for. Map textures are
+// larger than the screen, origin is where the screen's top left corner
+// falls in one.
+//
+typedef struct MapRaster {
+	float lon;
+	float lat;
+	float maxDist;
+	int originX;
+	int originY;
+} MapRaster;
+
+//
+// Quantized zoom level and map centre a raster was drawn for
+//
+typedef struct MapKey {
+	int level;
+	int cellX;
+	int cellY;
+
+	bool operator==(const MapKey &other) const {
+		return level == other.level && cellX == other.cellX && cellY == other.cellY;
+	}
+} MapKey;
+
+struct MapKeyHash {
+	size_t operator()(const MapKey &key) const;
+};
+
+//
+// Finished map rasters, so zooming or panning back to somewhere recently
+// seen needs no drawing. The least recently used are dropped once the
+// textures add up to more than budget, and their textures handed out again
+// for new rasters.
+//
+class MapCache {
+	public:
+		typedef struct Entry {
+			MapKey key;
+			MapRaster raster;
+			SDL_Texture *texture;
+			int w, h;
+		} Entry;
+
+		typedef std::list<Entry> EntryList;
+
+		unsigned int hits;
+		unsigned int misses;
+		unsigned int evictions;
+
+		size_t bytes;
+		size_t budget;
+
+		EntryList lru;		// most recently used first, for picking what to show
+
+		bool contains(const MapKey &key);
+		void touch(const MapKey &key);
+		SDL_Texture *take(SDL_Renderer *renderer, int w, int h);
+		void insert(const MapKey &key, const MapRaster &raster, SDL_Texture *texture, int w, int h);
+		void clear();
+
+		MapCache();
+		~MapCache();
+
+	private:
+		std::unordered_map<MapKey, EntryList::iterator, MapKeyHash> index;
+};
+
+#endif
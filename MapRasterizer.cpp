@@ -0,0 +1,491 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "MapRasterizer.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <math.h>
+
+MapRasterizer::MapRasterizer() {
+    map = NULL;
+    doneEvent = (Uint32) -1;
+    stopping = false;
+    hasPending = false;
+    working = false;
+    hasDone = false;
+    generation = 0;
+    lines = 0;
+
+    poolRound = 0;
+    poolBusy = 0;
+    poolStopping = false;
+    tileJob = NULL;
+    tilePixels = NULL;
+    tileGeneration = 0;
+    tilesX = 0;
+    tilesY = 0;
+    tileCursor = 0;
+}
+
+MapRasterizer::~MapRasterizer() {
+    stop();
+}
+
+//
+// Threads to draw tiles with, one per core up to MAP_RASTER_THREADS
+//
+int MapRasterizer::defaultThreads() {
+    int cores = (int) std::thread::hardware_concurrency();
+
+    return std::max(1, std::min(cores, MAP_RASTER_THREADS));
+}
+
+//
+// Worker thread plus a pool of threads - 1 tile helpers
+//
+void MapRasterizer::start(Map *map, Uint32 doneEvent, int threads) {
+    startPool(map, threads);
+
+    this->doneEvent = doneEvent;
+    stopping = false;
+    thread = std::thread(&MapRasterizer::run, this);
+}
+
+//
+// Just the tile helpers, for calling render() directly
+//
+void MapRasterizer::startPool(Map *map, int threads) {
+    this->map = map;
+    poolStopping = false;
+
+    for(int i = 1; i < threads; i++) {
+        helpers.push_back(std::thread(&MapRasterizer::runHelper, this));
+    }
+}
+
+void MapRasterizer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    generation++;
+    wake.notify_one();
+
+    if(thread.joinable()) {
+        thread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        poolStopping = true;
+    }
+
+    poolWake.notify_all();
+
+    for(size_t i = 0; i < helpers.size(); i++) {
+        helpers[i].join();
+    }
+
+    helpers.clear();
+}
+
+//
+// Draw job next, replacing anything queued or in progress
+//
+void MapRasterizer::request(const MapJob &job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = job;
+        hasPending = true;
+    }
+
+    generation++;
+    wake.notify_one();
+}
+
+//
+// A raster is queued, being drawn or waiting to be collected
+//
+bool MapRasterizer::busy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hasPending || working || hasDone;
+}
+
+//
+// Take the finished raster if there is one
+//
+bool MapRasterizer::collect(MapJob *job, std::vector<Uint32> *pixels) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if(!hasDone) {
+        return false;
+    }
+
+    *job = done;
+    pixels->swap(donePixels);
+    hasDone = false;
+
+    return true;
+}
+
+void MapRasterizer::run() {
+    std::vector<Uint32> pixels;
+
+    for(;;) {
+        MapJob job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || hasPending; });
+
+            if(stopping) {
+                return;
+            }
+
+            job = pending;
+            hasPending = false;
+            working = true;
+        }
+
+        bool finished = render(job, pixels);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            working = false;
+
+            if(finished) {
+                done = job;
+                donePixels.swap(pixels);
+                hasDone = true;
+            }
+        }
+
+        if(finished) {
+            SDL_Event event;
+
+            SDL_zero(event);
+            event.type = doneEvent;
+            SDL_PushEvent(&event);
+        }
+    }
+}
+
+void MapRasterizer::runHelper() {
+    uint32_t seen = 0;
+
+    for(;;) {
+        {
+            std::unique_lock<std::mutex> lock(poolMutex);
+            poolWake.wait(lock, [this, seen] { return poolStopping || poolRound != seen; });
+
+            if(poolStopping) {
+                return;
+            }
+
+            seen = poolRound;
+        }
+
+        drawTiles();
+
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            if(--poolBusy == 0) {
+                poolDone.notify_one();
+            }
+        }
+    }
+}
+
+//
+// Liang-Barsky clip of a segment to [0, w) x [0, h). Returns false if
+// nothing is left.
+//
+static bool clipLine(float *x1, float *y1, float *x2, float *y2, int w, int h) {
+    float t0 = 0, t1 = 1;
+    float dx = *x2 - *x1;
+    float dy = *y2 - *y1;
+    float p[4] = {-dx, dx, -dy, dy};
+    float q[4] = {*x1, (w - 1) - *x1, *y1, (h - 1) - *y1};
+
+    for(int i = 0; i < 4; i++) {
+        if(p[i] == 0) {
+            if(q[i] < 0) {
+                return false;
+            }
+            continue;
+        }
+
+        float t = q[i] / p[i];
+
+        if(p[i] < 0) {
+            t0 = std::max(t0, t);
+        } else {
+            t1 = std::min(t1, t);
+        }
+
+        if(t0 > t1) {
+            return false;
+        }
+    }
+
+    *x2 = *x1 + t1 * dx;
+    *y2 = *y1 + t1 * dy;
+    *x1 = *x1 + t0 * dx;
+    *y1 = *y1 + t0 * dy;
+
+    return true;
+}
+
+//
+// The map lines for job, projected the way View would and clipped to the
+// raster
+//
+void MapRasterizer::project(const MapJob &job, std::vector<MapSegment> &out) {
+    out.clear();
+
+    // lat/lon box of the whole texture, a little generous like
+    // View::latLonFromScreenCoords
+    float halfWidth = job.raster.maxDist * (job.width / 2) / (0.95 * job.scaleFactor * 0.5);
+    float halfHeight = job.raster.maxDist * (job.height / 2) / (0.95 * job.scaleFactor * 0.5);
+
+    float lat_min = job.raster.lat - 180.0f * halfHeight / (6371.0 * M_PI);
+    float lat_max = job.raster.lat + 180.0f * halfHeight / (6371.0 * M_PI);
+    float widest = std::min(std::max(fabs(lat_min), fabs(lat_max)), 89.0f);
+    float lonHalf = 180.0 * halfWidth / (cos(widest * M_PI / 180.0f) * 6371.0 * M_PI);
+
+    float scale = job.scaleFactor * 0.5 / job.raster.maxDist;
+    float originX = job.raster.originX + job.centerX;
+    float originY = job.raster.originY + job.centerY;
+
+    // each vertex projected once, then its segments clipped
+    auto visit = [&](const Point *points, int count) {
+        float x[POLYLINE_MAX_POINTS], y[POLYLINE_MAX_POINTS];
+
+        for(int k = 0; k < count; k++) {
+            float dx = LATLONMULT * (points[k].lon - job.raster.lon) * cos(((points[k].lat + job.raster.lat)/2.0f) * M_PI / 180.0f);
+            float dy = LATLONMULT * (points[k].lat - job.raster.lat);
+
+            x[k] = originX + ((dx>0) ? 1 : -1) * round(scale * fabs(dx));
+            y[k] = originY + ((dy>0) ? -1 : 1) * round(scale * fabs(dy));
+        }
+
+        for(int k = 0; k < count - 1; k++) {
+            float x1 = x[k], y1 = y[k], x2 = x[k + 1], y2 = y[k + 1];
+
+            if(x1 == x2 && y1 == y2) {
+                continue;
+            }
+
+            if(!clipLine(&x1, &y1, &x2, &y2, job.width, job.height)) {
+                continue;
+            }
+
+            MapSegment s = {(int) (x1 + 0.5f), (int) (y1 + 0.5f), (int) (x2 + 0.5f), (int) (y2 + 0.5f)};
+            out.push_back(s);
+        }
+    };
+
+    map->forEachPolyline(job.level, lat_min, lat_max, job.raster.lon - lonHalf, job.raster.lon + lonHalf, visit);
+}
+
+//
+// Counting sort of segments into every tile their bounding box touches
+//
+void MapRasterizer::binSegments(const MapJob &job) {
+    tilesX = (job.width + MAP_TILE - 1) / MAP_TILE;
+    tilesY = (job.height + MAP_TILE - 1) / MAP_TILE;
+
+    tileStart.assign(tilesX * tilesY + 1, 0);
+
+    for(int pass = 0; pass < 2; pass++) {
+        for(size_t i = 0; i < segments.size(); i++) {
+            const MapSegment &s = segments[i];
+
+            int left = std::min(s.x1, s.x2) / MAP_TILE;
+            int right = std::max(s.x1, s.x2) / MAP_TILE;
+            int top = std::min(s.y1, s.y2) / MAP_TILE;
+            int bottom = std::max(s.y1, s.y2) / MAP_TILE;
+
+            for(int ty = top; ty <= bottom; ty++) {
+                for(int tx = left; tx <= right; tx++) {
+                    if(pass == 0) {
+                        tileStart[ty * tilesX + tx + 1]++;
+                    } else {
+                        tileItems[tileStart[ty * tilesX + tx]++] = i;
+                    }
+                }
+            }
+        }
+
+        if(pass == 0) {
+            for(int t = 0; t < tilesX * tilesY; t++) {
+                tileStart[t + 1] += tileStart[t];
+            }
+
+            tileItems.resize(tileStart[tilesX * tilesY]);
+        } else {
+            // the fill pass moved every start up to the next tile's
+            for(int t = tilesX * tilesY; t > 0; t--) {
+                tileStart[t] = tileStart[t - 1];
+            }
+            tileStart[0] = 0;
+        }
+    }
+}
+
+//
+// The pixels of s inside the tile [x0, x1) x [y0, y1). Each pixel comes
+// from its step along the major axis by the midpoint rule, so a segment
+// split across tiles comes out exactly as if it were drawn whole.
+//
+static void drawSegment(Uint32 *pixels, int pitch, const MapSegment &s, int x0, int y0, int x1, int y1, Uint32 color) {
+    int ax = s.x1, ay = s.y1, bx = s.x2, by = s.y2;
+
+    // walk the major axis as x
+    bool steep = abs(by - ay) > abs(bx - ax);
+    if(steep) {
+        std::swap(ax, ay);
+        std::swap(bx, by);
+        std::swap(x0, y0);
+        std::swap(x1, y1);
+    }
+
+    int major = abs(bx - ax);
+    int minor = abs(by - ay);
+    int sx = (bx >= ax) ? 1 : -1;
+    int sy = (by >= ay) ? 1 : -1;
+
+    // steps whose major coordinate is inside the tile
+    int first = (sx > 0) ? x0 - ax : ax - (x1 - 1);
+    int last = (sx > 0) ? (x1 - 1) - ax : ax - x0;
+
+    first = std::max(first, 0);
+    last = std::min(last, major);
+
+    if(first > last) {
+        return;
+    }
+
+    int den = 2 * std::max(major, 1);
+    long num = 2L * first * minor + major;
+    int q = (int) (num / den);
+    int r = (int) (num % den);
+
+    int x = ax + sx * first;
+
+    for(int i = first; i <= last; i++) {
+        int y = ay + sy * q;
+
+        if(y >= y0 && y < y1) {
+            if(steep) {
+                pixels[x * pitch + y] = color;
+            } else {
+                pixels[y * pitch + x] = color;
+            }
+        }
+
+        x += sx;
+        r += 2 * minor;
+        if(r >= den) {
+            r -= den;
+            q++;
+        }
+    }
+}
+
+//
+// Claim tiles one at a time until there are none left. Run by the helpers
+// and the thread calling render() alike.
+//
+void MapRasterizer::drawTiles() {
+    int tiles = tilesX * tilesY;
+
+    for(;;) {
+        int t = tileCursor.fetch_add(1);
+
+        if(t >= tiles || generation != tileGeneration) {
+            return;
+        }
+
+        int x0 = (t % tilesX) * MAP_TILE;
+        int y0 = (t / tilesX) * MAP_TILE;
+        int x1 = std::min(x0 + MAP_TILE, tileJob->width);
+        int y1 = std::min(y0 + MAP_TILE, tileJob->height);
+
+        for(int k = tileStart[t]; k < tileStart[t + 1]; k++) {
+            drawSegment(tilePixels, tileJob->width, segments[tileItems[k]], x0, y0, x1, y1, tileJob->color);
+        }
+    }
+}
+
+//
+// Rasterize job into pixels on this thread and the tile helpers. Gives up
+// and returns false if a newer request comes in.
+//
+bool MapRasterizer::render(const MapJob &job, std::vector<Uint32> &pixels) {
+    ProfileScope scope(PROFILE_LINES);
+
+    tileGeneration = generation;
+
+    pixels.assign((size_t) job.width * job.height, job.background);
+
+    project(job, segments);
+    binSegments(job);
+
+    if(generation != tileGeneration) {
+        return false;
+    }
+
+    tileJob = &job;
+    tilePixels = pixels.data();
+    tileCursor = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        poolBusy = helpers.size();
+        poolRound++;
+    }
+
+    poolWake.notify_all();
+
+    drawTiles();
+
+    {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        poolDone.wait(lock, [this] { return poolBusy == 0; });
+    }
+
+    lines = segments.size();
+
+    return generation == tileGeneration;
+}
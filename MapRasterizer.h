@@ -0,0 +1,142 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef MAPRASTERIZER_H
+#define MAPRASTERIZER_H
+
+#include "SDL2/SDL.h"
+#include "Map.h"
+#include "MapCache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// One map raster to draw: the view, the texture size and the projection the
+// screen uses, so points land where View would put them
+//
+typedef struct MapJob {
+	MapKey key;
+	MapRaster raster;
+	int width;				// texture
+	int height;
+	int centerX;			// texture pixel of the view centre, less origin
+	int centerY;
+	float scaleFactor;		// pixels per 2 * maxDist
+	int level;				// Map::levels index
+	Uint32 background;		// ARGB8888
+	Uint32 color;
+} MapJob;
+
+#define MAP_TILE 64				//rasterizer tile size in pixels
+#define MAP_RASTER_THREADS 8		//most threads drawing tiles
+
+//
+// Segment projected and clipped to the raster, in pixels
+//
+typedef struct MapSegment {
+	int x1, y1;
+	int x2, y2;
+} MapSegment;
+
+//
+// Map raster worker. Draws the map lines for the latest requested view
+// into an ARGB8888 buffer on its own thread and posts doneEvent when it's
+// ready to collect. A new request abandons one in progress.
+//
+// Segments are binned into MAP_TILE square tiles and the tiles shared out
+// to a pool of helper threads. Each tile is drawn by exactly one thread, so
+// nothing in the framebuffer needs locking.
+//
+class MapRasterizer {
+	public:
+		std::atomic<int> lines;		// segments drawn by the last finished raster
+
+		void start(Map *map, Uint32 doneEvent, int threads);
+		void startPool(Map *map, int threads);
+		void stop();
+		void request(const MapJob &job);
+		bool busy();
+		bool collect(MapJob *job, std::vector<Uint32> *pixels);
+		bool render(const MapJob &job, std::vector<Uint32> &pixels);
+		static int defaultThreads();
+		void project(const MapJob &job, std::vector<MapSegment> &out);
+
+		MapRasterizer();
+		~MapRasterizer();
+
+	private:
+		Map *map;
+		Uint32 doneEvent;
+
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping;
+
+		MapJob pending;				// guarded by mutex
+		bool hasPending;
+		bool working;
+		MapJob done;
+		std::vector<Uint32> donePixels;
+		bool hasDone;
+
+		std::atomic<uint32_t> generation;	// bumped by every request, to abandon stale work
+
+		// tile pool, all but tileCursor only change between rounds
+		std::vector<std::thread> helpers;
+		std::mutex poolMutex;
+		std::condition_variable poolWake;
+		std::condition_variable poolDone;
+		uint32_t poolRound;
+		int poolBusy;
+		bool poolStopping;
+
+		const MapJob *tileJob;
+		Uint32 *tilePixels;
+		uint32_t tileGeneration;
+		int tilesX;
+		int tilesY;
+		std::atomic<int> tileCursor;
+		std::vector<MapSegment> segments;
+		std::vector<int> tileStart;			// counting sort of segments into tiles
+		std::vector<int> tileItems;
+
+		void run();
+		void runHelper();
+		void drawTiles();
+		void binSegments(const MapJob &job);
+};
+
+#endif
@@ -0,0 +1,183 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "PngWriter.h"
+
+#define PNG_STORED_BLOCK 65535 //largest stored deflate block
+
+static uint32_t crcTable[256];
+static bool crcTableReady = false;
+
+static void makeCrcTable() {
+    for(uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for(int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        crcTable[n] = c;
+    }
+    crcTableReady = true;
+}
+
+//
+// Byte sink that keeps the running chunk CRC and zlib Adler-32 up to date
+//
+struct PngStream {
+    FILE *f;
+    uint32_t crc;
+    uint32_t adlerA;
+    uint32_t adlerB;
+    bool ok;
+
+    void put(const uint8_t *data, size_t len) {
+        for(size_t i = 0; i < len; i++) {
+            crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        if(fwrite(data, 1, len, f) != len) {
+            ok = false;
+        }
+    }
+
+    // deflate payload also goes into the Adler-32
+    void putData(const uint8_t *data, size_t len) {
+        for(size_t i = 0; i < len; i++) {
+            adlerA = (adlerA + data[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        put(data, len);
+    }
+
+    void put32(uint32_t v) {
+        uint8_t b[4] = {(uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v};
+        put(b, 4);
+    }
+
+    // chunk length goes outside the CRC
+    void beginChunk(const char *type, uint32_t length) {
+        uint8_t b[4] = {(uint8_t)(length >> 24), (uint8_t)(length >> 16), (uint8_t)(length >> 8), (uint8_t)length};
+        if(fwrite(b, 1, 4, f) != 4) {
+            ok = false;
+        }
+        crc = 0xffffffffu;
+        put((const uint8_t *) type, 4);
+    }
+
+    void endChunk() {
+        uint32_t c = crc ^ 0xffffffffu;
+        uint8_t b[4] = {(uint8_t)(c >> 24), (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c};
+        if(fwrite(b, 1, 4, f) != 4) {
+            ok = false;
+        }
+    }
+};
+
+//
+// Write width x height RGB24 pixels, rows pitch bytes apart, as a PNG.
+// The whole image goes in one IDAT chunk whose length is worked out up front,
+// so rows are streamed straight from the pixel buffer.
+//
+bool writePng(FILE *f, const uint8_t *rgb, int width, int height, int pitch) {
+    if(width <= 0 || height <= 0) {
+        return false;
+    }
+
+    if(!crcTableReady) {
+        makeCrcTable();
+    }
+
+    PngStream s;
+    s.f = f;
+    s.adlerA = 1;
+    s.adlerB = 0;
+    s.ok = true;
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if(fwrite(signature, 1, 8, f) != 8) {
+        return false;
+    }
+
+    s.beginChunk("IHDR", 13);
+    s.put32(width);
+    s.put32(height);
+    uint8_t ihdr[5] = {8, 2, 0, 0, 0}; //8 bit, RGB, deflate, no filter, no interlace
+    s.put(ihdr, 5);
+    s.endChunk();
+
+    // every row is a filter type byte (0, none) then the pixels
+    size_t rowBytes = 3 * (size_t) width;
+    size_t raw = (size_t) height * (rowBytes + 1);
+    size_t blocks = (raw + PNG_STORED_BLOCK - 1) / PNG_STORED_BLOCK;
+
+    s.beginChunk("IDAT", (uint32_t) (2 + 5 * blocks + raw + 4));
+
+    uint8_t zlibHeader[2] = {0x78, 0x01};
+    s.put(zlibHeader, 2);
+
+    size_t left = raw;          // payload not yet given a block header
+    size_t blockLeft = 0;       // payload still to go in the current block
+    const uint8_t filter = 0;
+
+    for(int y = 0; y < height; y++) {
+        const uint8_t *parts[2] = {&filter, rgb + (size_t) y * pitch};
+        size_t sizes[2] = {1, rowBytes};
+
+        for(int part = 0; part < 2; part++) {
+            const uint8_t *data = parts[part];
+            size_t len = sizes[part];
+
+            while(len) {
+                if(blockLeft == 0) {
+                    blockLeft = (left < PNG_STORED_BLOCK) ? left : PNG_STORED_BLOCK;
+                    left -= blockLeft;
+
+                    uint8_t header[5] = {(uint8_t) (left == 0 ? 1 : 0),
+                        (uint8_t) blockLeft, (uint8_t) (blockLeft >> 8),
+                        (uint8_t) ~blockLeft, (uint8_t) (~blockLeft >> 8)};
+                    s.put(header, 5);
+                }
+
+                size_t n = (len < blockLeft) ? len : blockLeft;
+                s.putData(data, n);
+                data += n;
+                len -= n;
+                blockLeft -= n;
+            }
+        }
+    }
+
+    s.put32((s.adlerB << 16) | s.adlerA);
+    s.endChunk();
+
+    s.beginChunk("IEND", 0);
+    s.endChunk();
+
+    return s.ok;
+}
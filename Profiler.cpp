@@ -0,0 +1,199 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+Profiler profiler;
+
+const char *profileStageNames[PROFILE_STAGES] = {
+	"ingest",
+	"decode",
+	"moveMapToTarget",
+	"resolveLabelConflicts",
+	"drawGeography",
+	"drawLines",
+	"drawPlanes",
+	"drawStatus",
+	"SDL_RenderPresent"
+};
+
+static std::atomic<int> threadCount(0);
+static thread_local int threadId = -1;
+static thread_local ProfileScope *innermost = nullptr;
+
+//
+// Claim a slot, then publish it with its sequence number so a reader never
+// takes a half written event
+//
+void Profiler::record(ProfileStage stage, std::chrono::high_resolution_clock::time_point start, uint32_t duration, uint32_t self) {
+    if(threadId < 0) {
+        threadId = threadCount.fetch_add(1);
+    }
+
+    uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+    ProfileEvent *e = &ring[index & (PROFILE_RING_SIZE - 1)];
+
+    e->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    e->stage = stage;
+    e->thread = threadId;
+    e->start = std::chrono::duration_cast<std::chrono::microseconds>(start - epoch).count();
+    e->duration = duration;
+
+    e->seq.store(index + 1, std::memory_order_release);
+
+    current[stage].fetch_add(self, std::memory_order_relaxed);
+}
+
+//
+// Close the running frame's stage totals into the history
+//
+void Profiler::endFrame() {
+    uint32_t *frame = frames[frameCount % PROFILE_FRAMES];
+
+    for(int i = 0; i < PROFILE_STAGES; i++) {
+        frame[i] = current[i].exchange(0, std::memory_order_relaxed);
+    }
+
+    frameCount++;
+}
+
+uint32_t Profiler::percentile(int stage, float p) {
+    int n = std::min(frameCount, PROFILE_FRAMES);
+    uint32_t values[PROFILE_FRAMES];
+
+    if(n == 0) {
+        return 0;
+    }
+
+    for(int i = 0; i < n; i++) {
+        if(stage < PROFILE_STAGES) {
+            values[i] = frames[i][stage];
+        } else {
+            values[i] = 0;
+            for(int j = 0; j < PROFILE_STAGES; j++) {
+                values[i] += frames[i][j];
+            }
+        }
+    }
+
+    int k = std::min(n - 1, (int) (p * n));
+    std::nth_element(values, values + k, values + n);
+
+    return values[k];
+}
+
+//
+// Write what's left in the ring as Chrome trace JSON (chrome://tracing or
+// Perfetto), complete events only
+//
+bool Profiler::writeTrace(const char *path) {
+    FILE *f = fopen(path, "w");
+
+    if(!f) {
+        return false;
+    }
+
+    uint32_t end = head.load(std::memory_order_acquire);
+    uint32_t begin = (end > PROFILE_RING_SIZE) ? end - PROFILE_RING_SIZE : 0;
+    bool first = true;
+
+    fprintf(f, "{\"traceEvents\":[\n");
+
+    for(uint32_t i = begin; i < end; i++) {
+        ProfileEvent *e = &ring[i & (PROFILE_RING_SIZE - 1)];
+
+        if(e->seq.load(std::memory_order_acquire) != i + 1) {
+            continue;
+        }
+
+        uint8_t stage = e->stage;
+        uint8_t thread = e->thread;
+        uint64_t start = e->start;
+        uint32_t duration = e->duration;
+
+        // overwritten while we were copying it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(e->seq.load(std::memory_order_relaxed) != i + 1) {
+            continue;
+        }
+
+        fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"viz1090\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":1,\"tid\":%d}",
+            first ? "" : ",\n", profileStageNames[stage], (unsigned long long) start, duration, thread);
+        first = false;
+    }
+
+    fprintf(f, "\n]}\n");
+
+    return fclose(f) == 0;
+}
+
+Profiler::Profiler() {
+    epoch = std::chrono::high_resolution_clock::now();
+    ring = new ProfileEvent[PROFILE_RING_SIZE];
+    head = 0;
+    frameCount = 0;
+
+    for(int i = 0; i < PROFILE_RING_SIZE; i++) {
+        ring[i].seq = 0;
+    }
+
+    for(int i = 0; i < PROFILE_STAGES; i++) {
+        current[i] = 0;
+    }
+}
+
+Profiler::~Profiler() {
+    delete[] ring;
+}
+
+ProfileScope::ProfileScope(ProfileStage stage) {
+    this->stage = stage;
+    children = 0;
+    parent = innermost;
+    innermost = this;
+    start = std::chrono::high_resolution_clock::now();
+}
+
+ProfileScope::~ProfileScope() {
+    uint32_t duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    innermost = parent;
+    if(parent) {
+        parent->children += duration;
+    }
+
+    profiler.record(stage, start, duration, (duration > children) ? duration - children : 0);
+}
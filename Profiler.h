@@ -0,0 +1,108 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+#define PROFILE_RING_SIZE 65536	//scopes kept for trace export, power of 2
+#define PROFILE_FRAMES 128			//frames kept for the overlay and percentiles
+
+typedef enum {
+	PROFILE_INGEST,
+	PROFILE_DECODE,
+	PROFILE_MOVE,
+	PROFILE_LABELS,
+	PROFILE_GEOGRAPHY,
+	PROFILE_LINES,
+	PROFILE_PLANES,
+	PROFILE_STATUS,
+	PROFILE_PRESENT,
+	PROFILE_STAGES
+} ProfileStage;
+
+extern const char *profileStageNames[PROFILE_STAGES];
+
+typedef struct ProfileEvent {
+	std::atomic<uint32_t> seq;	// ring index + 1 once written, 0 while being written
+	uint8_t stage;
+	uint8_t thread;
+	uint64_t start;				// us since the profiler started
+	uint32_t duration;			// us, including nested scopes
+} ProfileEvent;
+
+//
+// Frame profiler. Every scope lands in a lock-free ring for Chrome trace
+// export, and its self time (minus nested scopes) is added to the current
+// frame's per-stage totals for the overlay. Ingest and decode happen between
+// draws, so they count towards the frame that follows them.
+//
+class Profiler {
+	public:
+		uint32_t frames[PROFILE_FRAMES][PROFILE_STAGES];	// self time per stage, us
+		int frameCount;
+
+		void record(ProfileStage stage, std::chrono::high_resolution_clock::time_point start, uint32_t duration, uint32_t self);
+		void endFrame();
+		uint32_t percentile(int stage, float p);	// over the kept frames, PROFILE_STAGES for frame totals
+		bool writeTrace(const char *path);
+
+		Profiler();
+		~Profiler();
+
+	private:
+		std::chrono::high_resolution_clock::time_point epoch;
+		ProfileEvent *ring;
+		std::atomic<uint32_t> head;
+		std::atomic<uint32_t> current[PROFILE_STAGES];
+};
+
+extern Profiler profiler;
+
+//
+// Times the enclosing block as one stage
+//
+class ProfileScope {
+	public:
+		ProfileScope(ProfileStage stage);
+		~ProfileScope();
+
+	private:
+		ProfileStage stage;
+		std::chrono::high_resolution_clock::time_point start;
+		uint32_t children;		// us spent in nested scopes
+		ProfileScope *parent;
+};
+
+#endif
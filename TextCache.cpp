@@ -0,0 +1,158 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "TextCache.h"
+
+static Uint32 packColor(SDL_Color color) {
+    return (Uint32)color.r << 16 | (Uint32)color.g << 8 | (Uint32)color.b;
+}
+
+size_t TextKeyHash::operator()(const TextKey &key) const {
+    size_t h = std::hash<std::string>()(key.text);
+
+    h ^= std::hash<void *>()(key.glyphs) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= std::hash<Uint32>()(key.color) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= std::hash<Uint32>()(key.bgColor) + 0x9e3779b9 + (h << 6) + (h >> 2);
+
+    return h;
+}
+
+TextCache::TextCache() {
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    frameHits = 0;
+    frameMisses = 0;
+    frameStartHits = 0;
+    frameStartMisses = 0;
+
+    bytes = 0;
+    budget = TEXT_CACHE_BYTES;
+}
+
+TextCache::~TextCache() {
+    clear();
+}
+
+//
+// Texture with text drawn on bgColor, rendering it from the glyph atlas
+// into a new target texture if it isn't cached. Returns NULL for empty text
+// or if the texture can't be made.
+//
+SDL_Texture *TextCache::get(SDL_Renderer *renderer, GlyphAtlas *glyphs, const char *text, SDL_Color color, SDL_Color bgColor, int *w, int *h) {
+    TextKey key;
+
+    key.glyphs = glyphs;
+    key.color = packColor(color);
+    key.bgColor = packColor(bgColor);
+    key.text = text;
+
+    std::unordered_map<TextKey, EntryList::iterator, TextKeyHash>::iterator found = index.find(key);
+
+    if(found != index.end()) {
+        lru.splice(lru.begin(), lru, found->second);
+        hits++;
+
+        *w = found->second->w;
+        *h = found->second->h;
+        return found->second->texture;
+    }
+
+    misses++;
+
+    Entry entry;
+
+    entry.w = glyphs->measure(text);
+    entry.h = glyphs->height;
+
+    if(!entry.w || !entry.h) {
+        return NULL;
+    }
+
+    entry.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, entry.w, entry.h);
+
+    if(!entry.texture) {
+        return NULL;
+    }
+
+    SDL_Texture *target = SDL_GetRenderTarget(renderer);
+
+    SDL_SetRenderTarget(renderer, entry.texture);
+    SDL_SetRenderDrawColor(renderer, bgColor.r, bgColor.g, bgColor.b, SDL_ALPHA_OPAQUE);
+    SDL_RenderClear(renderer);
+    glyphs->draw(renderer, text, 0, 0, color);
+    SDL_SetRenderTarget(renderer, target);
+
+    SDL_SetTextureBlendMode(entry.texture, SDL_BLENDMODE_NONE);
+
+    entry.key = key;
+    lru.push_front(entry);
+    index[key] = lru.begin();
+    bytes += entry.w * entry.h * 4;
+
+    while(bytes > budget && lru.size() > 1) {
+        Entry &oldest = lru.back();
+
+        bytes -= oldest.w * oldest.h * 4;
+        SDL_DestroyTexture(oldest.texture);
+        index.erase(oldest.key);
+        lru.pop_back();
+        evictions++;
+    }
+
+    *w = entry.w;
+    *h = entry.h;
+    return entry.texture;
+}
+
+//
+// Roll the per frame counters over, call once at the start of each frame
+//
+void TextCache::newFrame() {
+    frameHits = hits - frameStartHits;
+    frameMisses = misses - frameStartMisses;
+
+    frameStartHits = hits;
+    frameStartMisses = misses;
+}
+
+//
+// Drop every texture, at shutdown or when the renderer has lost them
+//
+void TextCache::clear() {
+    for(EntryList::iterator it = lru.begin(); it != lru.end(); ++it) {
+        SDL_DestroyTexture(it->texture);
+    }
+
+    lru.clear();
+    index.clear();
+    bytes = 0;
+}
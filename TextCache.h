@@ -0,0 +1,97 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include "GlyphAtlas.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#define TEXT_CACHE_BYTES (16 * 1024 * 1024) //texture memory kept for rendered strings
+
+typedef struct TextKey {
+    GlyphAtlas *glyphs;
+    Uint32 color;
+    Uint32 bgColor;
+    std::string text;
+
+    bool operator==(const TextKey &other) const {
+        return glyphs == other.glyphs && color == other.color && bgColor == other.bgColor && text == other.text;
+    }
+} TextKey;
+
+struct TextKeyHash {
+    size_t operator()(const TextKey &key) const;
+};
+
+//
+// Strings drawn on a solid background, kept as textures so a label that
+// hasn't changed since the last frame is a single copy. The least recently
+// used strings are dropped once the textures add up to more than budget.
+//
+class TextCache {
+	public:
+		unsigned int hits;
+		unsigned int misses;
+		unsigned int evictions;
+		unsigned int frameHits;		// during the last complete frame
+		unsigned int frameMisses;
+
+		size_t bytes;
+		size_t budget;
+
+		SDL_Texture *get(SDL_Renderer *renderer, GlyphAtlas *glyphs, const char *text, SDL_Color color, SDL_Color bgColor, int *w, int *h);
+		void newFrame();
+		void clear();
+
+		TextCache();
+		~TextCache();
+
+	private:
+		typedef struct Entry {
+			TextKey key;
+			SDL_Texture *texture;
+			int w, h;
+		} Entry;
+
+		typedef std::list<Entry> EntryList;
+
+		EntryList lru;		// most recently used first
+		std::unordered_map<TextKey, EntryList::iterator, TextKeyHash> index;
+
+		unsigned int frameStartHits;
+		unsigned int frameStartMisses;
+};
+
+#endif
@@ -37,9 +37,17 @@
 #include "monokai.h"
 
 #include "View.h"
+#include "PngWriter.h"
+#include "Profiler.h"
 
 #include <iostream>
 #include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 using fmilliseconds = std::chrono::duration<float, std::milli>;
 using fseconds = std::chrono::duration<float>;
@@ -236,7 +244,7 @@ TTF_Font* View::loadFont(const char *name, int size)
 
     if (font == NULL)
     {
-        printf("Failed to open Font %s: %s\n", name, TTF_GetError());
+        fprintf(stderr, "Failed to open Font %s: %s\n", name, TTF_GetError());
 
         exit(1);
     }
@@ -258,16 +266,43 @@ void View::closeFont(TTF_Font *font)
 
 void View::SDL_init() {
     
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        printf("Could not initialize SDL: %s\n", SDL_GetError());       
+    if (SDL_Init(headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO) < 0) {
+        fprintf(stderr, "Could not initialize SDL: %s\n", SDL_GetError());       
         exit(1);
     }
     
     if (TTF_Init() < 0) {
-        printf("Couldn't initialize SDL TTF: %s\n", SDL_GetError());
+        fprintf(stderr, "Couldn't initialize SDL TTF: %s\n", SDL_GetError());
         exit(1);
     }
 
+    sdlStarted = true;
+
+    mapMoved = 1;
+    mapTargetLon = 0;
+    mapTargetLat = 0;
+    mapTargetMaxDist = 0;
+
+    if(headless) {
+        // software renderer drawing into a plain surface, no video driver
+        if(screen_width == 0) {
+            screen_width = 800;
+            screen_height = 800;
+        }
+
+        window = NULL;
+        surface = SDL_CreateRGBSurfaceWithFormat(0, screen_width, screen_height, 32, SDL_PIXELFORMAT_ARGB8888);
+        renderer = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+
+        if(!renderer) {
+            fprintf(stderr, "Couldn't create offscreen renderer: %s\n", SDL_GetError());
+            exit(1);
+        }
+
+        sizeMapTextures();
+        return;
+    }
+
     SDL_ShowCursor(SDL_DISABLE);
 
     Uint32 flags = 0;
@@ -285,15 +320,7 @@ void View::SDL_init() {
 
     window =  SDL_CreateWindow("viz1090",  SDL_WINDOWPOS_CENTERED_DISPLAY(screen_index),  SDL_WINDOWPOS_CENTERED_DISPLAY(screen_index), screen_width, screen_height, flags);        
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    mapTexture = SDL_CreateTexture(renderer,
-                               SDL_PIXELFORMAT_ARGB8888,
-                               SDL_TEXTUREACCESS_TARGET,
-                               screen_width, screen_height);
-
-    mapMoved = 1;
-    mapTargetLon = 0;
-    mapTargetLat = 0;
-    mapTargetMaxDist = 0;
+    sizeMapTextures();
 
     if(fullscreen) {
         //SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");  // make the scaled rendering look smoother.
@@ -301,6 +328,43 @@ void View::SDL_init() {
     }
 }
 
+//
+// Map textures are overscanned by MAP_OVERSCAN on each side so small pans
+// only shift the copy. Renderers that can't take textures that big get
+// screen sized ones.
+//
+void View::sizeMapTextures() {
+    mapTextureWidth = screen_width + 2 * (int) (MAP_OVERSCAN * screen_width);
+    mapTextureHeight = screen_height + 2 * (int) (MAP_OVERSCAN * screen_height);
+
+    SDL_Texture *test = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, mapTextureWidth, mapTextureHeight);
+
+    if(test) {
+        SDL_DestroyTexture(test);
+    } else {
+        mapTextureWidth = screen_width;
+        mapTextureHeight = screen_height;
+    }
+}
+
+//
+// Map rasters are drawn off the main thread, which gets woken by
+// rasterEvent to upload each one
+//
+void View::startRasterizer() {
+    rasterEvent = SDL_RegisterEvents(1);
+    rasterizer.start(&map, rasterEvent, MapRasterizer::defaultThreads());
+}
+
+//
+// Glyph atlases for the fonts, again after a render device reset as that
+// loses every texture
+//
+bool View::buildGlyphs() {
+    return mapGlyphs.build(renderer, mapFont) && mapBoldGlyphs.build(renderer, mapBoldFont) &&
+        messageGlyphs.build(renderer, messageFont) && labelGlyphs.build(renderer, labelFont);
+}
+
 void View::font_init() {
     mapFont = loadFont("font/TerminusTTF-4.46.0.ttf", 12 * screen_uiscale);
     mapBoldFont = loadFont("font/TerminusTTF-Bold-4.46.0.ttf", 12 * screen_uiscale);    
@@ -310,19 +374,29 @@ void View::font_init() {
     messageFont = loadFont("font/TerminusTTF-Bold-4.46.0.ttf", 12 * screen_uiscale);
     labelFont = loadFont("font/TerminusTTF-Bold-4.46.0.ttf", 12 * screen_uiscale);
 
-    mapFontWidth = 5 * screen_uiscale;
-    mapFontHeight = 12 * screen_uiscale; 
+    if(!buildGlyphs()) {
+        exit(1);
+    }
 
-    messageFontWidth = 6 * screen_uiscale;
-    messageFontHeight = 12 * screen_uiscale; 
+    mapFontWidth = mapGlyphs.width;
+    mapFontHeight = mapGlyphs.height; 
 
-    labelFontWidth = 6 * screen_uiscale;
-    labelFontHeight = 12 * screen_uiscale; 
+    messageFontWidth = messageGlyphs.width;
+    messageFontHeight = messageGlyphs.height; 
 
-    //
-    // todo separate style stuff
-    //
+    labelFontWidth = labelGlyphs.width;
+    labelFontHeight = labelGlyphs.height; 
+
+    // Started last, as nothing after this exit()s: exit() skips ~View, and
+    // the worker would still be running while static destructors run
+    startRasterizer();
+}
 
+//
+// Colours, set up by the constructor as --bench-raster draws with them
+// before SDL_init()
+//
+void View::style_init() {
     SDL_Color bgcolor = {0,0,20,255};
     SDL_Color greenblue = {236,192,68,255};
     SDL_Color lightblue = {211,208,203,255};
@@ -339,68 +413,53 @@ void View::font_init() {
     style.buttonColor =  lightblue;
 }
 
-void View::drawString(std::string text, int x, int y, TTF_Font *font, SDL_Color color)
+void View::drawString(std::string text, int x, int y, GlyphAtlas *glyphs, SDL_Color color)
 {
     if(!text.length()) { 
         return;
     }
 
-    SDL_Surface *surface;
-    SDL_Rect dest;
-
-    surface = TTF_RenderUTF8_Solid(font, text.c_str(), color);
-
-    if (surface == NULL)
-    {
-        printf("Couldn't create String %s: %s\n", text.c_str(), SDL_GetError());
+    glyphs->draw(renderer, text.c_str(), x, y, color);
+}
 
+//
+// Text on a solid background. Strings that change nearly every frame (frame
+// rate, per frame counters) should pass cache = false: they would only
+// ever miss in textCache and cost a new target texture each time, so they
+// are drawn straight from the glyph atlas over a filled rectangle instead.
+//
+void View::drawStringBG(std::string text, int x, int y, GlyphAtlas *glyphs, SDL_Color color, SDL_Color bgColor, bool cache) {
+    if(!text.length()) { 
         return;
     }
-    
-    dest.x = x;
-    dest.y = y;
-    dest.w = surface->w;
-    dest.h = surface->h;
 
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_RenderCopy(renderer, texture, NULL, &dest);
-    SDL_DestroyTexture(texture);
-    SDL_FreeSurface(surface);
-}
+    if(!cache) {
+        SDL_Rect box = {x, y, glyphs->measure(text.c_str()), glyphs->height};
 
-void View::drawStringBG(std::string text, int x, int y, TTF_Font *font, SDL_Color color, SDL_Color bgColor) {
-    if(!text.length()) { 
+        SDL_SetRenderDrawColor(renderer, bgColor.r, bgColor.g, bgColor.b, SDL_ALPHA_OPAQUE);
+        SDL_RenderFillRect(renderer, &box);
+        glyphs->draw(renderer, text.c_str(), x, y, color);
         return;
     }
-        
-    SDL_Surface *surface;
-    SDL_Rect dest;
-
-    surface = TTF_RenderUTF8_Shaded(font, text.c_str(), color, bgColor);
 
-    if (surface == NULL)
-    {
-        printf("Couldn't create String %s: %s\n", text.c_str(), SDL_GetError());
+    SDL_Rect dest;
+    SDL_Texture *texture = textCache.get(renderer, glyphs, text.c_str(), color, bgColor, &dest.w, &dest.h);
 
+    if(texture == NULL) {
         return;
     }
-    
+
     dest.x = x;
     dest.y = y;
-    dest.w = surface->w;
-    dest.h = surface->h;
 
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
     SDL_RenderCopy(renderer, texture, NULL, &dest);
-    SDL_DestroyTexture(texture);
-    SDL_FreeSurface(surface);
 }
 
 //
 // Status boxes
 //
 
-void View::drawStatusBox(int *left, int *top, std::string label, std::string message, SDL_Color color) {
+void View::drawStatusBox(int *left, int *top, std::string label, std::string message, SDL_Color color, bool cache) {
     int labelWidth = (label.length() + ((label.length() > 0 ) ? 1 : 0)) * labelFontWidth;
     int messageWidth = (message.length() + ((message.length() > 0 ) ? 1 : 0)) * messageFontWidth;
 
@@ -419,16 +478,16 @@ void View::drawStatusBox(int *left, int *top, std::string label, std::string mes
         roundedBoxRGBA(renderer, *left, *top, *left + labelWidth, *top + messageFontHeight, ROUND_RADIUS,color.r, color.g, color.b, SDL_ALPHA_OPAQUE);
     }
 
-    // outline message box
+    drawStringBG(label, *left + labelFontWidth/2, *top, &labelGlyphs, black, color);
+
+    //message
+    drawStringBG(message, *left + labelWidth + messageFontWidth/2, *top, &messageGlyphs, color, black, cache);
+
+    // outline message box, after the text so its background doesn't cover it
     if(messageWidth) {
         roundedRectangleRGBA(renderer, *left, *top, *left + labelWidth + messageWidth, *top + messageFontHeight, ROUND_RADIUS,color.r, color.g, color.b, SDL_ALPHA_OPAQUE);
     }
 
-    drawString(label, *left + labelFontWidth/2, *top, labelFont, black);
-
-    //message
-    drawString(message, *left + labelWidth + messageFontWidth/2, *top, messageFont, color);
-
     *left = *left + labelWidth + messageWidth + PAD;
 }
 
@@ -453,6 +512,76 @@ void View::drawStatus() {
     snprintf(strSig, 18, "%.0f%%", 100.0 * appData->avgSig / 1024.0);
     drawStatusBox(&left, &top, "sAvg", strSig, style.buttonColor);
 
+    // Aircraft records in use / most ever in use, from the aircraft pool
+    char strPool[24] = " ";
+    snprintf(strPool, 24, "%u/%u", appData->modes.aircraftStore.pool.live, appData->modes.aircraftStore.pool.highWater);
+    drawStatusBox(&left, &top, "recs", strPool, style.buttonColor);
+
+    // Text cache hits/misses over the last frame
+    char strText[24] = " ";
+    snprintf(strText, 24, "%u/%u", textCache.frameHits, textCache.frameMisses);
+    drawStatusBox(&left, &top, "text", strText, style.buttonColor, false);
+
+    // Geometry submissions/triangles for icons and trails this frame
+    char strGeo[24] = " ";
+    snprintf(strGeo, 24, "%u/%u", iconBatch.calls + trailBatch.calls, iconBatch.triangles + trailBatch.triangles);
+    drawStatusBox(&left, &top, "geo", strGeo, style.buttonColor, false);
+}
+
+//
+// Profiler overlay: self time per stage for the last PROFILE_FRAMES frames
+// as stacked bars against the frame budget, with p50/p99 for each stage
+//
+void View::drawProfile() {
+    int barWidth = 2 * screen_uiscale;
+    float msHeight = 4.0f * screen_uiscale;
+    int graphHeight = (int) (2 * FRAMETIME * msHeight);
+    int graphWidth = PROFILE_FRAMES * barWidth;
+    int left = screen_width - graphWidth - PAD;
+    int top = PAD;
+
+    SDL_Color stageColors[PROFILE_STAGES];
+    for(int i = 0; i < PROFILE_STAGES; i++) {
+        int k = i * 127 / (PROFILE_STAGES - 1);
+        stageColors[i] = {(Uint8) parula[k][0], (Uint8) parula[k][1], (Uint8) parula[k][2], 255};
+    }
+
+    boxRGBA(renderer, left, top, left + graphWidth, top + graphHeight, black.r, black.g, black.b, 192);
+
+    // oldest frame on the left
+    int n = std::min(profiler.frameCount, PROFILE_FRAMES);
+    for(int f = 0; f < n; f++) {
+        uint32_t *frame = profiler.frames[(profiler.frameCount - n + f) % PROFILE_FRAMES];
+        float x = left + (PROFILE_FRAMES - n + f) * barWidth;
+        float y = top + graphHeight;
+
+        for(int i = 0; i < PROFILE_STAGES && y > top; i++) {
+            float h = std::min(frame[i] / 1000.0f * msHeight, y - top);
+
+            if(h > 0) {
+                iconBatch.triangle(x, y, x + barWidth, y, x + barWidth, y - h, stageColors[i]);
+                iconBatch.triangle(x, y, x + barWidth, y - h, x, y - h, stageColors[i]);
+                y -= h;
+            }
+        }
+    }
+    iconBatch.flush(renderer);
+
+    int budget = top + graphHeight - (int) (FRAMETIME * msHeight);
+    lineRGBA(renderer, left, budget, left + graphWidth, budget, grey.r, grey.g, grey.b, 255);
+
+    // legend, ms at p50/p99
+    int y = top + graphHeight + PAD;
+    boxRGBA(renderer, left, y, left + graphWidth, y + (PROFILE_STAGES + 1) * messageFontHeight, black.r, black.g, black.b, 192);
+
+    for(int i = 0; i <= PROFILE_STAGES; i++) {
+        char line[64];
+        snprintf(line, 64, "%-21.21s %5.1f %5.1f", (i < PROFILE_STAGES) ? profileStageNames[i] : "frame",
+            profiler.percentile(i, 0.5f) / 1000.0f, profiler.percentile(i, 0.99f) / 1000.0f);
+
+        drawString(line, left + PAD, y, &messageGlyphs, (i < PROFILE_STAGES) ? stageColors[i] : white);
+        y += messageFontHeight;
+    }
 }
 
 //
@@ -504,7 +633,7 @@ void View::drawPlaneOffMap(int x, int y, int *returnx, int *returny, SDL_Color p
     y2 = (screen_height * CENTEROFFSET) + outy - 2.0 * arrowWidth * vec[1] + round(arrowWidth*out[1]);
     x3 = (screen_width>>1) +  outx - arrowWidth * vec[0];
     y3 = (screen_height * CENTEROFFSET) + outy - arrowWidth * vec[1];
-    filledTrigonRGBA(renderer, x1, y1, x2, y2, x3, y3, planeColor.r,planeColor.g,planeColor.b,SDL_ALPHA_OPAQUE);
+    iconBatch.triangle(x1, y1, x2, y2, x3, y3, planeColor);
 
     // arrow 2
     x1 = (screen_width>>1) + outx - 3.0 * arrowWidth * vec[0] + round(-arrowWidth*out[0]);
@@ -513,7 +642,7 @@ void View::drawPlaneOffMap(int x, int y, int *returnx, int *returny, SDL_Color p
     y2 = (screen_height * CENTEROFFSET) + outy - 3.0 * arrowWidth * vec[1] + round(arrowWidth*out[1]);
     x3 = (screen_width>>1) +  outx - 2.0 * arrowWidth * vec[0];
     y3 = (screen_height * CENTEROFFSET) + outy - 2.0 * arrowWidth * vec[1];
-    filledTrigonRGBA(renderer, x1, y1, x2, y2, x3, y3, planeColor.r,planeColor.g,planeColor.b,SDL_ALPHA_OPAQUE);
+    iconBatch.triangle(x1, y1, x2, y2, x3, y3, planeColor);
 
     *returnx = x3;
     *returny = y3;
@@ -545,9 +674,9 @@ void View::drawPlaneIcon(int x, int y, float heading, SDL_Color planeColor)
     x2 = x + round(body*vec[0]);
     y2 = y + round(body*vec[1]);
 
-    thickLineRGBA(renderer,x,y,x2,y2,bodyWidth,planeColor.r,planeColor.g,planeColor.b,SDL_ALPHA_OPAQUE);
-    filledTrigonRGBA(renderer, x + round(-wing*.35*out[0]), y + round(-wing*.35*out[1]), x + round(wing*.35*out[0]), y + round(wing*.35*out[1]), x1, y1,planeColor.r,planeColor.g,planeColor.b,SDL_ALPHA_OPAQUE);        
-    filledCircleRGBA(renderer, x2,y2,screen_uiscale,planeColor.r,planeColor.g,planeColor.b,SDL_ALPHA_OPAQUE);
+    iconBatch.line(x, y, x2, y2, bodyWidth, planeColor);
+    iconBatch.triangle(x + round(-wing*.35*out[0]), y + round(-wing*.35*out[1]), x + round(wing*.35*out[0]), y + round(wing*.35*out[1]), x1, y1, planeColor);
+    iconBatch.disc(x2, y2, screen_uiscale, planeColor);
 
     //wing
     x1 = x + round(-wing*out[0]);
@@ -555,7 +684,7 @@ void View::drawPlaneIcon(int x, int y, float heading, SDL_Color planeColor)
     x2 = x + round(wing*out[0]);
     y2 = y + round(wing*out[1]);
 
-    filledTrigonRGBA(renderer, x1, y1, x2, y2, x+round(body*.35*vec[0]), y+round(body*.35*vec[1]),planeColor.r,planeColor.g,planeColor.b,SDL_ALPHA_OPAQUE);
+    iconBatch.triangle(x1, y1, x2, y2, x+round(body*.35*vec[0]), y+round(body*.35*vec[1]), planeColor);
 
     //tail
     x1 = x + round(-body*.75*vec[0]) + round(-tail*out[0]);
@@ -563,51 +692,48 @@ void View::drawPlaneIcon(int x, int y, float heading, SDL_Color planeColor)
     x2 = x + round(-body*.75*vec[0]) + round(tail*out[0]);
     y2 = y + round(-body*.75*vec[1]) + round(tail*out[1]);
 
-    filledTrigonRGBA (renderer, x1, y1, x2, y2, x+round(-body*.5*vec[0]), y+round(-body*.5*vec[1]),planeColor.r,planeColor.g,planeColor.b,SDL_ALPHA_OPAQUE);
+    iconBatch.triangle(x1, y1, x2, y2, x+round(-body*.5*vec[0]), y+round(-body*.5*vec[1]), planeColor);
 }
 
 void View::drawTrails(int left, int top, int right, int bottom) {
     int currentX, currentY, prevX, prevY;
     float dx, dy;   
 
-    Aircraft *p = appData->aircraftList.head;
+    for(int i = 0; i < snapshot.count; i++) {
+        Aircraft *p = appData->aircraftList.display(snapshot.handle[i]);
 
-    while(p) {
-        if (p->lon && p->lat) {
-            if(p->lonHistory.empty()) {
-                    return;
-                }
+        if(p->trail.empty()) {
+            continue;
+        }
 
-                std::vector<float>::iterator lon_idx = p->lonHistory.begin();
-                std::vector<float>::iterator lat_idx = p->latHistory.begin();
-                std::vector<float>::iterator heading_idx = p->headingHistory.begin();
+        std::vector<TrailPoint>::iterator point = p->trail.begin();
 
-                int idx = p->lonHistory.size();
+        int idx = p->trail.size();
 
-                for(; std::next(lon_idx) != p->lonHistory.end(); ++lon_idx, ++lat_idx, ++heading_idx) {
+        for(; std::next(point) != p->trail.end(); ++point) {
 
-                    pxFromLonLat(&dx, &dy, *(std::next(lon_idx)), *(std::next(lat_idx)));
-                    screenCoords(&currentX, &currentY, dx, dy);
+            pxFromLonLat(&dx, &dy, std::next(point)->lon, std::next(point)->lat);
+            screenCoords(&currentX, &currentY, dx, dy);
 
-                    pxFromLonLat(&dx, &dy, *lon_idx, *lat_idx);
+            pxFromLonLat(&dx, &dy, point->lon, point->lat);
 
-                    screenCoords(&prevX, &prevY, dx, dy);
-                    if(outOfBounds(currentX,currentY,left,top,right,bottom) && outOfBounds(prevX,prevY,left,top,right,bottom)) {
-                        continue;
-                    }
+            screenCoords(&prevX, &prevY, dx, dy);
+            if(outOfBounds(currentX,currentY,left,top,right,bottom) && outOfBounds(prevX,prevY,left,top,right,bottom)) {
+                continue;
+            }
 
-                    // float age = pow(1.0 - (float)idx / (float)p->lonHistory.size(), 2.2);
-                    float age = 1.0 - (float)idx / (float)p->lonHistory.size();
+            // float age = pow(1.0 - (float)idx / (float)p->trail.size(), 2.2);
+            float age = 1.0 - (float)idx / (float)p->trail.size();
 
-                    uint8_t colorVal = (uint8_t)floor(255.0 * clamp(age,0,0.5));
-                               
-                    thickLineRGBA(renderer, prevX, prevY, currentX, currentY, 2 * screen_uiscale, 255, 255, 255, colorVal); 
+            SDL_Color trailColor = {255, 255, 255, (uint8_t)floor(255.0 * clamp(age,0,0.5))};
+                       
+            trailBatch.line(prevX, prevY, currentX, currentY, 2 * screen_uiscale, trailColor);
 
-                    idx--;
-                }
+            idx--;
         }
-        p = p->next;
     }
+
+    trailBatch.flush(renderer);
 }
 
 void View::drawScaleBars()
@@ -628,7 +754,7 @@ void View::drawScaleBars()
             snprintf(scaleLabel,13,"%dmi", (int)pow(10,scalePower));
         }
 
-        drawString(scaleLabel, 10+scaleBarDist, 15*screen_uiscale, mapFont, style.scaleBarColor);
+        drawString(scaleLabel, 10+scaleBarDist, 15*screen_uiscale, &mapGlyphs, style.scaleBarColor);
 
         scalePower++;
         scaleBarDist = screenDist((float)pow(10,scalePower));
@@ -641,179 +767,287 @@ void View::drawScaleBars()
 }
 
 
-void View::drawLines(int left, int top, int right, int bottom, int bailTime) {
-    float screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max;
+//
+// Map raster. Textures are drawn for a fixed MapRaster and copied shifted
+// and scaled while the view moves, so panning within the margin costs
+// nothing. Rasters are drawn at quantized zoom levels and centres and kept
+// in mapCache. A new one is drawn a slice per frame and used once it's done.
+//
 
-    latLonFromScreenCoords(&screen_lat_min, &screen_lon_min, left, top);
-    latLonFromScreenCoords(&screen_lat_max, &screen_lon_max, right, bottom);
+//
+// Cache key for a view, and the quantized view the raster is drawn for
+//
+MapKey View::mapKey(float maxDist, float lat, float lon, MapRaster *raster) {
+    MapKey key;
+
+    key.level = (int) round(MAP_ZOOM_STEPS * log2(maxDist));
+    raster->maxDist = pow(2.0, (double) key.level / MAP_ZOOM_STEPS);
+
+    float cellKm = MAP_CELL * raster->maxDist;
+
+    key.cellY = (int) floor(lat * LATLONMULT / cellKm + 0.5);
+    raster->lat = key.cellY * cellKm / LATLONMULT;
 
-    drawLinesRecursive(&(map.root), screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
+    float lonScale = LATLONMULT * cos(raster->lat * M_PI / 180.0f);
 
-    drawTrails(left, top, right, bottom);
+    key.cellX = (int) floor(lon * lonScale / cellKm + 0.5);
+    raster->lon = key.cellX * cellKm / lonScale;
+
+    raster->originX = (mapTextureWidth - screen_width) / 2;
+    raster->originY = (mapTextureHeight - screen_height) / 2;
+
+    return key;
 }
 
-void View::drawLinesRecursive(QuadTree *tree, float screen_lat_min, float screen_lat_max, float screen_lon_min, float screen_lon_max) {
-    if(tree == NULL) {
-        return;
-    }
+//
+// Where a texture drawn for raster lands on screen at the current view
+//
+void View::rasterDest(const MapRaster &raster, SDL_Rect *dest) {
+    float scale = raster.maxDist / maxDist;
+    int x, y;
 
-    if (tree->lat_min > screen_lat_max || screen_lat_min > tree->lat_max) {
-        return; 
-    }
+    // not pxFromLonLat, a raster can be centred on the equator or meridian
+    float dx = LATLONMULT * (raster.lon - centerLon) * cos(((raster.lat + centerLat)/2.0f) * M_PI / 180.0f);
+    float dy = LATLONMULT * (raster.lat - centerLat);
 
-    if (tree->lon_min > screen_lon_max || screen_lon_min > tree->lon_max) {
-        return; 
-    }
-    
-    drawLinesRecursive(tree->nw, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
-    
-    drawLinesRecursive(tree->sw, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
-    
-    drawLinesRecursive(tree->ne, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
-    
-    drawLinesRecursive(tree->se, screen_lat_min, screen_lat_max, screen_lon_min, screen_lon_max);
+    screenCoords(&x, &y, dx, dy);
 
-    std::vector<Line*>::iterator currentLine;
+    dest->x = x - (int) round((raster.originX + (screen_width>>1)) * scale);
+    dest->y = y - (int) round((raster.originY + screen_height * CENTEROFFSET) * scale);
+    dest->w = (int) round(mapTextureWidth * scale);
+    dest->h = (int) round(mapTextureHeight * scale);
+}
 
-    for (currentLine = tree->lines.begin(); currentLine != tree->lines.end(); ++currentLine) {
-        int x1,y1,x2,y2;
-        float dx,dy;
-    
-        pxFromLonLat(&dx, &dy, (*currentLine)->start.lon, (*currentLine)->start.lat); 
-        screenCoords(&x1, &y1, dx, dy);
+int View::coversScreen(SDL_Rect *dest) {
+    return dest->x <= 0 && dest->y <= 0 && dest->x + dest->w >= screen_width && dest->y + dest->h >= screen_height;
+}
 
-        pxFromLonLat(&dx, &dy, (*currentLine)->end.lon, (*currentLine)->end.lat); 
-        screenCoords(&x2, &y2, dx, dy);
+//
+// Of the cached rasters that cover the screen, the one nearest the current
+// zoom, and the nearest one zoomed the other way to blend under it
+// (weighted by how close each is) or NULL. base is only NULL if nothing
+// cached is on screen at all.
+//
+void View::pickRasters(MapCache::Entry **base, MapCache::Entry **under, float *alpha) {
+    float level = MAP_ZOOM_STEPS * log2(maxDist);
+    float baseDiff = 0;
+    float underDiff = 0;
 
-        lineCount++;
+    *base = NULL;
+    *under = NULL;
+    *alpha = 1.0f;
 
-        if(outOfBounds(x1,y1) && outOfBounds(x2,y2)) {
-            continue;
-        }
+    for(MapCache::EntryList::iterator it = mapCache.lru.begin(); it != mapCache.lru.end(); ++it) {
+        SDL_Rect dest;
+        rasterDest(it->raster, &dest);
 
-        if(x1 == x2 && y1 == y2) {
+        if(!coversScreen(&dest)) {
             continue;
         }
 
-        lineRGBA(renderer, x1, y1, x2, y2, style.mapInnerColor.r, style.mapInnerColor.g, style.mapInnerColor.b, 255);     
+        float diff = level - it->key.level;
+
+        if(!*base || fabs(diff) < fabs(baseDiff)) {
+            *base = &(*it);
+            baseDiff = diff;
+        }
     }
 
-    // //Debug quadtree
-    // int tl_x,tl_y,tr_x,tr_y,bl_x,bl_y,br_x,br_y;
-    // float dx,dy;
+    if(!*base) {
+        // nothing covers it, show the nearest zoom that's on screen at all
+        // until the raster thread catches up
+        for(MapCache::EntryList::iterator it = mapCache.lru.begin(); it != mapCache.lru.end(); ++it) {
+            SDL_Rect dest;
+            rasterDest(it->raster, &dest);
 
-    // pxFromLonLat(&dx, &dy, tree->lon_min, tree->lat_min); 
-    // screenCoords(&tl_x, &tl_y, dx, dy);
+            if(dest.x >= screen_width || dest.y >= screen_height || dest.x + dest.w <= 0 || dest.y + dest.h <= 0) {
+                continue;
+            }
 
-    // pxFromLonLat(&dx, &dy, tree->lon_max, tree->lat_min); 
-    // screenCoords(&tr_x, &tr_y, dx, dy);
+            float diff = level - it->key.level;
+
+            if(!*base || fabs(diff) < fabs(baseDiff)) {
+                *base = &(*it);
+                baseDiff = diff;
+            }
+        }
 
-    // pxFromLonLat(&dx, &dy, tree->lon_min, tree->lat_max); 
-    // screenCoords(&bl_x, &bl_y, dx, dy);
+        return;
+    }
 
-    // pxFromLonLat(&dx, &dy, tree->lon_max, tree->lat_max); 
-    // screenCoords(&br_x, &br_y, dx, dy);    
+    if(baseDiff == 0) {
+        return;
+    }
 
-    // lineRGBA(renderer, tl_x, tl_y, tr_x, tr_y, 50, 50, 50, 255);     
-    // lineRGBA(renderer, tr_x, tr_y, br_x, br_y, 50, 50, 50, 255);     
-    // lineRGBA(renderer, bl_x, bl_y, br_x, br_y, 50, 50, 50, 255);     
-    // lineRGBA(renderer, tl_x, tl_y, bl_x, bl_y, 50, 50, 50, 255);  
+    for(MapCache::EntryList::iterator it = mapCache.lru.begin(); it != mapCache.lru.end(); ++it) {
+        float diff = level - it->key.level;
 
-    // // pixelRGBA(renderer,tl_x, tl_y,255,0,0,255);
-    // pixelRGBA(renderer,tr_x, tr_y,0,255,0,255);
-    // pixelRGBA(renderer,bl_x, bl_y,0,0,255,255);
-    // pixelRGBA(renderer,br_x, br_y,255,255,0,255);
+        if((diff > 0) == (baseDiff > 0) || diff == 0) {
+            continue;
+        }
 
-   
+        SDL_Rect dest;
+        rasterDest(it->raster, &dest);
+
+        if(coversScreen(&dest) && (!*under || fabs(diff) < fabs(underDiff))) {
+            *under = &(*it);
+            underDiff = diff;
+        }
+    }
+
+    if(*under) {
+        *alpha = fabs(underDiff) / (fabs(baseDiff) + fabs(underDiff));
+    }
 }
 
+//
+// Ask the raster thread for a view, unless it's already on it
+//
+void View::requestRaster(const MapKey &key, const MapRaster &raster) {
+    if(rasterActive && rasterKey == key) {
+        return;
+    }
 
-void View::drawGeography() {
+    rasterizer.request(rasterJob(key, raster));
 
-    if((mapRedraw && !mapMoved) || (mapAnimating && elapsed(lastRedraw) > 8 * FRAMETIME)) {
+    rasterKey = key;
+    rasterActive = true;
+}
 
-        SDL_SetRenderTarget(renderer, mapTexture);
-        
-        SDL_SetRenderDrawColor(renderer, style.backgroundColor.r, style.backgroundColor.g, style.backgroundColor.b, 255);
+//
+// What the raster thread needs to draw raster at the current screen size
+// and style
+//
+MapJob View::rasterJob(const MapKey &key, const MapRaster &raster) {
+    MapJob job;
+
+    job.key = key;
+    job.raster = raster;
+    job.width = mapTextureWidth;
+    job.height = mapTextureHeight;
+    job.centerX = screen_width>>1;
+    job.centerY = screen_height * CENTEROFFSET;
+    job.scaleFactor = (screen_width > screen_height) ? screen_width : screen_height;
+
+    // coarsest map level that's still finer than a pixel, so the line count
+    // stays about the same as the view zooms out
+    job.level = map.levelFor(2 * raster.maxDist / job.scaleFactor / LATLONMULT);
+    job.background = 0xff000000 | style.backgroundColor.r << 16 | style.backgroundColor.g << 8 | style.backgroundColor.b;
+    job.color = 0xff000000 | style.mapInnerColor.r << 16 | style.mapInnerColor.g << 8 | style.mapInnerColor.b;
+
+    return job;
+}
 
-        SDL_RenderClear(renderer);
-        
-        drawLines(0, 0, screen_width, screen_height, 0);
+//
+// Upload a finished raster, if there is one, into a cache texture
+//
+void View::collectRaster() {
+    MapJob job;
 
-        SDL_SetRenderTarget(renderer, NULL );   
+    if(!rasterizer.collect(&job, &rasterPixels)) {
+        return;
+    }
 
-        mapMoved = 0;
-        mapRedraw = 0;
-        mapAnimating = 0;
+    if(job.key == rasterKey) {
+        rasterActive = false;
+    }
 
-        lastRedraw = now();
+    // the screen was resized or the renderer reset since it was asked for
+    if(job.width != mapTextureWidth || job.height != mapTextureHeight) {
+        return;
+    }
 
-        currentLon = centerLon;
-        currentLat = centerLat;
-        currentMaxDist = maxDist;
+    SDL_Texture *texture = mapCache.take(renderer, job.width, job.height);
+
+    if(!texture) {
+        return;
     }
-    
 
+    SDL_UpdateTexture(texture, NULL, rasterPixels.data(), job.width * sizeof(Uint32));
+    mapCache.insert(job.key, job.raster, texture, job.width, job.height);
+}
 
-    SDL_SetRenderDrawColor(renderer, style.backgroundColor.r, style.backgroundColor.g, style.backgroundColor.b, 255);
+//
+// Waiting on the raster thread for a map we asked for
+//
+bool View::rasterPending() {
+    return rasterActive;
+}
 
-    SDL_RenderClear(renderer);
+void View::drawGeography() {
+    if(mapRedraw) {
+        // targets were reset, nothing uploaded so far is any good
+        mapCache.clear();
+    }
 
-    int shiftx = 0;
-    int shifty = 0;
+    collectRaster();
 
-    if(mapMoved) {
-        float dx, dy;
-        int x1,y1, x2, y2;
-        pxFromLonLat(&dx, &dy, currentLon, currentLat);
-        screenCoords(&x1, &y1, dx, dy);
-        pxFromLonLat(&dx, &dy, centerLon, centerLat);
-        screenCoords(&x2, &y2, dx, dy);
+    MapCache::Entry *base, *under;
+    float alpha;
 
-        shiftx = x1-x2; 
-        shifty = y1-y2;
+    pickRasters(&base, &under, &alpha);
 
-        SDL_Rect dest;
+    MapRaster raster;
+    MapKey key;
+    SDL_Rect dest;
 
-        dest.x = shiftx + (screen_width / 2) * (1 - currentMaxDist / maxDist);
-        dest.y = shifty + (screen_height / 2) * (1 - currentMaxDist / maxDist);
-        dest.w = screen_width * currentMaxDist / maxDist;
-        dest.h = screen_height * currentMaxDist / maxDist;
+    if(base) {
+        rasterDest(base->raster, &dest);
+    }
 
-        //left
-        if(dest.x > 0) {
-           drawLines(0, 0, dest.x, screen_height, FRAMETIME / 4);    
-        }        
+    if(!base || !coversScreen(&dest)) {
+        // nothing cached covers the screen, get the current view first
+        key = mapKey(maxDist, centerLat, centerLon, &raster);
+        requestRaster(key, raster);
+    } else {
+        // only raster where a zoom or pan animation will end up
+        float targetDist = mapTargetMaxDist ? mapTargetMaxDist : maxDist;
+        float targetLat = (mapTargetLon && mapTargetLat) ? mapTargetLat : centerLat;
+        float targetLon = (mapTargetLon && mapTargetLat) ? mapTargetLon : centerLon;
+
+        key = mapKey(targetDist, targetLat, targetLon, &raster);
 
-        //top
-        if(dest.y > 0) {
-            drawLines(0, screen_height - dest.y, screen_width, screen_height, FRAMETIME / 4);    
+        if(!mapCache.contains(key)) {
+            requestRaster(key, raster);
         }
+    }
 
-        //right
-        if(dest.x + dest.w < screen_width) {
-           drawLines(dest.x + dest.w, 0, screen_width, screen_height, FRAMETIME / 4);    
-        }        
+    // cross fade levels only while a zoom animates, at rest show one
+    if(!mapAnimating) {
+        under = NULL;
+    }
 
-        //bottom
-        if(dest.y + dest.h < screen_height) {
-            drawLines(0, 0, screen_width, screen_height - dest.y - dest.h, FRAMETIME / 4);    
-        }        
+    SDL_SetRenderDrawColor(renderer, style.backgroundColor.r, style.backgroundColor.g, style.backgroundColor.b, 255);
 
-        //attempt rest before bailing
-        //drawGeography(dest.x, screen_height - dest.y, dest.x + dest.w, screen_height - dest.y - dest.h, 1);    
+    SDL_RenderClear(renderer);
 
-        SDL_RenderCopy(renderer, mapTexture, NULL, &dest);
+    if(under) {
+        rasterDest(under->raster, &dest);
+        SDL_SetTextureBlendMode(under->texture, SDL_BLENDMODE_NONE);
+        SDL_RenderCopy(renderer, under->texture, NULL, &dest);
+        mapCache.touch(under->key);
+    }
 
-        mapRedraw = 1;
-        mapMoved = 0;
-    } else {
-        SDL_RenderCopy(renderer, mapTexture, NULL, NULL);
+    if(base) {
+        rasterDest(base->raster, &dest);
+        SDL_SetTextureBlendMode(base->texture, under ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+        SDL_SetTextureAlphaMod(base->texture, under ? (Uint8) (255 * alpha) : 255);
+        SDL_RenderCopy(renderer, base->texture, NULL, &dest);
+        mapCache.touch(base->key);
     }
+
+    drawTrails(0, 0, screen_width, screen_height);
+
+    lineCount = rasterizer.lines;
+
+    mapMoved = 0;
+    mapRedraw = 0;
+    mapAnimating = 0;
 }
 
-void View::drawSignalMarks(Aircraft *p, int x, int y) {
-    unsigned char * pSig       = p->signalLevel;
+void View::drawSignalMarks(int h, int x, int y) {
+    Aircraft *p = appData->aircraftList.display(h);
+    unsigned char * pSig       = appData->aircraftList.hot(h)->signalLevel;
     unsigned int signalAverage = (pSig[0] + pSig[1] + pSig[2] + pSig[3] + 
                                               pSig[4] + pSig[5] + pSig[6] + pSig[7] + 3) >> 3; 
 
@@ -836,7 +1070,14 @@ void View::drawSignalMarks(Aircraft *p, int x, int y) {
 }
 
 
-void View::drawPlaneText(Aircraft *p) {
+void View::drawPlaneText(int i) {
+    int handle = snapshot.handle[i];
+    struct aircraft *a = appData->aircraftList.hot(handle);
+    int x = snapshot.x[i];
+    int y = snapshot.y[i];
+    int cx = snapshot.cx[i];
+    int cy = snapshot.cy[i];
+
     int maxCharCount = 0;
     int currentCharCount;
 
@@ -844,30 +1085,30 @@ void View::drawPlaneText(Aircraft *p) {
 
     float pressure_scale = 2.0f; //this should be set  by a UI slider eventually
 
-    if(p->pressure * screen_width < pressure_scale) {
-        drawSignalMarks(p, p->x, p->y);
+    if(snapshot.pressure[i] * screen_width < pressure_scale) {
+        drawSignalMarks(handle, x, y);
 
         char flight[10] = " ";
-        maxCharCount = snprintf(flight,10," %s", p->flight);
+        maxCharCount = snprintf(flight,10," %s", appData->aircraftList.cold(handle)->flight);
 
         if(maxCharCount > 1) {
-            drawStringBG(flight, p->x, p->y, mapBoldFont, white, black); 
-            //roundedRectangleRGBA(renderer, p->x, p->y, p->x + maxCharCount * mapFontWidth, p->y + mapFontHeight, ROUND_RADIUS, white.r, white.g, white.b, SDL_ALPHA_OPAQUE);
-            //drawString(flight, p->x, p->y, mapBoldFont, white); 
+            drawStringBG(flight, x, y, &mapBoldGlyphs, white, black); 
+            //roundedRectangleRGBA(renderer, x, y, x + maxCharCount * mapFontWidth, y + mapFontHeight, ROUND_RADIUS, white.r, white.g, white.b, SDL_ALPHA_OPAQUE);
+            //drawString(flight, x, y, &mapBoldGlyphs, white); 
             currentLine++;             
         }
     }
 
-  if(p->pressure * screen_width < 0.5f * pressure_scale) {
+  if(snapshot.pressure[i] * screen_width < 0.5f * pressure_scale) {
         char alt[10] = " ";
         if (metric) {
-            currentCharCount = snprintf(alt,10," %dm", (int) (p->altitude / 3.2828)); 
+            currentCharCount = snprintf(alt,10," %dm", (int) (a->altitude / 3.2828)); 
         } else {
-            currentCharCount = snprintf(alt,10," %d'", p->altitude); 
+            currentCharCount = snprintf(alt,10," %d'", a->altitude); 
         }
 
         if(currentCharCount > 1) {
-            drawStringBG(alt, p->x, p->y + currentLine * mapFontHeight, mapFont, grey, black);   
+            drawStringBG(alt, x, y + currentLine * mapFontHeight, &mapGlyphs, grey, black);   
             currentLine++;                              
         }
 
@@ -877,13 +1118,13 @@ void View::drawPlaneText(Aircraft *p) {
 
         char speed[10] = " ";
         if (metric) {
-            currentCharCount = snprintf(speed,10," %dkm/h", (int) (p->speed * 1.852));
+            currentCharCount = snprintf(speed,10," %dkm/h", (int) (a->speed * 1.852));
         } else {
-            currentCharCount = snprintf(speed,10," %dmph", p->speed);
+            currentCharCount = snprintf(speed,10," %dmph", a->speed);
         }
 
         if(currentCharCount > 1) {
-            drawStringBG(speed, p->x, p->y + currentLine * mapFontHeight, mapFont, grey, black);  
+            drawStringBG(speed, x, y + currentLine * mapFontHeight, &mapGlyphs, grey, black);  
             currentLine++;               
         }
 
@@ -895,37 +1136,40 @@ void View::drawPlaneText(Aircraft *p) {
     if(maxCharCount > 1) {
 
         Sint16 vx[4] = {
-            static_cast<Sint16>(p->cx), 
-            static_cast<Sint16>(p->cx + (p->x - p->cx) / 2), 
-            static_cast<Sint16>(p->x), 
-            static_cast<Sint16>(p->x)};
+            static_cast<Sint16>(cx), 
+            static_cast<Sint16>(cx + (x - cx) / 2), 
+            static_cast<Sint16>(x), 
+            static_cast<Sint16>(x)};
 
         Sint16 vy[4] = {
-            static_cast<Sint16>(p->cy), 
-            static_cast<Sint16>(p->cy + (p->y - p->cy) / 2), 
-            static_cast<Sint16>(p->y - mapFontHeight), 
-            static_cast<Sint16>(p->y)};
+            static_cast<Sint16>(cy), 
+            static_cast<Sint16>(cy + (y - cy) / 2), 
+            static_cast<Sint16>(y - mapFontHeight), 
+            static_cast<Sint16>(y)};
         
-        if(p->cy > p->y + currentLine * mapFontHeight) {
-            vy[2] = p->y + currentLine * mapFontHeight + mapFontHeight;
-            vy[3] = p->y + currentLine * mapFontHeight;
+        if(cy > y + currentLine * mapFontHeight) {
+            vy[2] = y + currentLine * mapFontHeight + mapFontHeight;
+            vy[3] = y + currentLine * mapFontHeight;
         } 
 
         bezierRGBA(renderer,vx,vy,4,2,200,200,200,SDL_ALPHA_OPAQUE);
 
 
-        thickLineRGBA(renderer,p->x,p->y,p->x,p->y+currentLine*mapFontHeight,screen_uiscale,200,200,200,SDL_ALPHA_OPAQUE);
+        thickLineRGBA(renderer,x,y,x,y+currentLine*mapFontHeight,screen_uiscale,200,200,200,SDL_ALPHA_OPAQUE);
     }
     
-    p->w = maxCharCount * mapFontWidth;
-    p->h = currentLine * mapFontHeight;         
+    snapshot.w[i] = maxCharCount * mapFontWidth;
+    snapshot.h[i] = currentLine * mapFontHeight;         
 }
 
-void View::drawSelectedAircraftText(Aircraft *p) {
-    if(p == NULL) {
+void View::drawSelectedAircraftText(int h) {
+    if(h == AIRCRAFT_NONE) {
         return;
     }
 
+    Aircraft *p = appData->aircraftList.display(h);
+    struct aircraft *a = appData->aircraftList.hot(h);
+
     int x = p->cx - 20;
     int y = p->cy + 22;
 
@@ -938,27 +1182,27 @@ void View::drawSelectedAircraftText(Aircraft *p) {
         circleRGBA(renderer, p->cx, p->cy, elapsed(p->msSeenLatLon) * screen_width / (8192), 255,255, 255, 64 - (uint8_t)(64.0 * elapsed(p->msSeenLatLon) / 500.0));   
     }
 
-    drawSignalMarks(p, x, y);
+    drawSignalMarks(h, x, y);
 
     char flight[10] = " ";
-    maxCharCount = snprintf(flight,10," %s", p->flight);
+    maxCharCount = snprintf(flight,10," %s", appData->aircraftList.cold(h)->flight);
 
     if(maxCharCount > 1) {
-        drawStringBG(flight, x, y, mapBoldFont, white, black); 
+        drawStringBG(flight, x, y, &mapBoldGlyphs, white, black); 
         //roundedRectangleRGBA(renderer, p->x, p->y, p->x + maxCharCount * mapFontWidth, p->y + mapFontHeight, ROUND_RADIUS, white.r, white.g, white.b, SDL_ALPHA_OPAQUE);
-        //drawString(flight, p->x, p->y, mapBoldFont, white); 
+        //drawString(flight, p->x, p->y, &mapBoldGlyphs, white); 
         currentLine++;             
     }
 
     char alt[10] = " ";
     if (metric) {
-        currentCharCount = snprintf(alt,10," %dm", (int) (p->altitude / 3.2828)); 
+        currentCharCount = snprintf(alt,10," %dm", (int) (a->altitude / 3.2828)); 
     } else {
-        currentCharCount = snprintf(alt,10," %d'", p->altitude); 
+        currentCharCount = snprintf(alt,10," %d'", a->altitude); 
     }
 
     if(currentCharCount > 1) {
-        drawStringBG(alt, x, y + currentLine * mapFontHeight, mapFont, grey, black);   
+        drawStringBG(alt, x, y + currentLine * mapFontHeight, &mapGlyphs, grey, black);   
         currentLine++;                              
     }
 
@@ -968,19 +1212,73 @@ void View::drawSelectedAircraftText(Aircraft *p) {
 
     char speed[10] = " ";
     if (metric) {
-        currentCharCount = snprintf(speed,10," %dkm/h", (int) (p->speed * 1.852));
+        currentCharCount = snprintf(speed,10," %dkm/h", (int) (a->speed * 1.852));
     } else {
-        currentCharCount = snprintf(speed,10," %dmph", p->speed);
+        currentCharCount = snprintf(speed,10," %dmph", a->speed);
     }
 
     if(currentCharCount > 1) {
-        drawStringBG(speed, x, y + currentLine * mapFontHeight, mapFont, grey, black);  
+        drawStringBG(speed, x, y + currentLine * mapFontHeight, &mapGlyphs, grey, black);  
         currentLine++;               
     }
+
+    // Comm-B registers, decoded by AircraftList only for the selected aircraft
+    struct commB *cb = &appData->aircraftList.selectedCommB;
+    char commBLines[5][16];
+    int commBCount = 0;
+
+    if(cb->valid & COMMB_BDS40_MCP_VALID) {
+        if (metric) {
+            snprintf(commBLines[commBCount++], 16, " sel %dm", (int) (cb->selAltMCP / 3.2828));
+        } else {
+            snprintf(commBLines[commBCount++], 16, " sel %d'", cb->selAltMCP);
+        }
+    }
+
+    if(cb->valid & COMMB_BDS60_HDG_VALID) {
+        snprintf(commBLines[commBCount++], 16, " hdg %03d", (int) cb->heading);
+    }
+
+    if(cb->valid & COMMB_BDS50_ROLL_VALID) {
+        snprintf(commBLines[commBCount++], 16, " roll %d", (int) cb->roll);
+    }
+
+    if(cb->valid & COMMB_BDS60_IAS_VALID) {
+        snprintf(commBLines[commBCount++], 16, " ias %dkt", cb->ias);
+    }
+
+    if(cb->valid & COMMB_BDS60_MACH_VALID) {
+        snprintf(commBLines[commBCount++], 16, " M%.2f", cb->mach);
+    }
+
+    for(int i = 0; i < commBCount; i++) {
+        drawStringBG(commBLines[i], x, y + currentLine * mapFontHeight, &mapGlyphs, grey, black);
+        currentLine++;
+    }
+
+    // Downlink formats of its latest messages from the DF log, newest first
+    if(appData->aircraftList.selectedDFCount) {
+        char dfLine[24] = " df";
+        int len = 3;
+
+        for(int i = 0; i < appData->aircraftList.selectedDFCount; i++) {
+            len += snprintf(dfLine + len, sizeof(dfLine) - len, " %d", appData->aircraftList.selectedDF[i].msg[0] >> 3);
+        }
+
+        drawStringBG(dfLine, x, y + currentLine * mapFontHeight, &mapGlyphs, grey, black);
+        currentLine++;
+    }
 }
 
+//
+// Push labels apart, away from plane icons and back on screen. Labels are
+// bucketed into a grid first so each one is only tested against its
+// neighbours. Label pressure sums over the planes in the neighbouring cells
+// of a coarser grid one by one, and over the rest a cell at a time as if
+// they all sat at the cell's mean position.
+//
 void View::resolveLabelConflicts() {
-    Aircraft *p = appData->aircraftList.head;
+    AircraftSnapshot &s = snapshot;
 
     float label_force = 0.01f;
     float plane_force = 0.01f;
@@ -988,279 +1286,652 @@ void View::resolveLabelConflicts() {
     float spring_force = 0.02f;
     float spring_length = 10.0f;
 
-    while(p) {
+    int maxW = 0;
+    int maxH = 0;
 
-        Aircraft *check_p = appData->aircraftList.head;
+    for(int i = 0; i < s.count; i++) {
+        if(s.w[i] > maxW) {
+            maxW = s.w[i];
+        }
+        if(s.h[i] > maxH) {
+            maxH = s.h[i];
+        }
+    }
+
+    labelGrid.build(s.x.data(), s.y.data(), s.count, screen_width, screen_height, LABEL_CELL * screen_uiscale);
+    iconGrid.build(s.cx.data(), s.cy.data(), s.count, screen_width, screen_height, LABEL_PRESSURE_CELL * screen_uiscale);
 
-        int p_left = p->x - 10 * screen_uiscale;
-        int p_right = p->x + p->w + 10 * screen_uiscale;
-        int p_top = p->y - 10 * screen_uiscale;
-        int p_bottom = p->y + p->h + 10 * screen_uiscale;
+    for(int i = 0; i < s.count; i++) {
+
+        int p_left = s.x[i] - 10 * screen_uiscale;
+        int p_right = s.x[i] + s.w[i] + 10 * screen_uiscale;
+        int p_top = s.y[i] - 10 * screen_uiscale;
+        int p_bottom = s.y[i] + s.h[i] + 10 * screen_uiscale;
 
         //debug box 
-        //rectangleRGBA(renderer, p->x, p->y, p->x + p->w, p->y + p->h, 255,0,0, SDL_ALPHA_OPAQUE);
-        //lineRGBA(renderer, p->cx, p->cy, p->x, p->y, 0,255,0, SDL_ALPHA_OPAQUE);
+        //rectangleRGBA(renderer, s.x[i], s.y[i], s.x[i] + s.w[i], s.y[i] + s.h[i], 255,0,0, SDL_ALPHA_OPAQUE);
+        //lineRGBA(renderer, s.cx[i], s.cy[i], s.x[i], s.y[i], 0,255,0, SDL_ALPHA_OPAQUE);
         
-        p->ddox = 0;
-        p->ddoy = 0;
+        s.ddox[i] = 0;
+        s.ddoy[i] = 0;
 
-        float o_mag = sqrt(p->ox*p->ox + p->oy*p->oy);
+        float o_mag = sqrt(s.ox[i]*s.ox[i] + s.oy[i]*s.oy[i]);
 
         //spring back to origin
 
         if(o_mag > 0) {
-            p->ddox -= p->ox / o_mag * spring_force * (o_mag - spring_length);
-            p->ddoy -= p->oy / o_mag * spring_force * (o_mag - spring_length);
+            s.ddox[i] -= s.ox[i] / o_mag * spring_force * (o_mag - spring_length);
+            s.ddoy[i] -= s.oy[i] / o_mag * spring_force * (o_mag - spring_length);
         }
         
         // // //screen edge 
 
         if(p_left < 10 * screen_uiscale) {
-            p->ox += (float)(10 * screen_uiscale - p_left);
+            s.ox[i] += (float)(10 * screen_uiscale - p_left);
         }
 
         if(p_right > (screen_width - 10 * screen_uiscale)) {
-            p->ox -= (float)(p_right - (screen_width - 10 * screen_uiscale));
+            s.ox[i] -= (float)(p_right - (screen_width - 10 * screen_uiscale));
         }
 
         if(p_top < 10 * screen_uiscale) {
-            p->oy += (float)(10 * screen_uiscale - p_top);
+            s.oy[i] += (float)(10 * screen_uiscale - p_top);
         }
 
         if(p_bottom > (screen_height - 10 * screen_uiscale)) {
-            p->oy -= (float)(p_bottom - (screen_height - 10 * screen_uiscale));
+            s.oy[i] -= (float)(p_bottom - (screen_height - 10 * screen_uiscale));
         }
 
-        p->pressure = 0;
+        //crowding from nearby planes, used to drop label lines
+
+        s.pressure[i] = 0;
 
+        int icon_row = iconGrid.row(s.cy[i]);
+        int icon_col = iconGrid.col(s.cx[i]);
+
+        for(int row = 0; row < iconGrid.rows; row++) {
+            for(int col = 0; col < iconGrid.cols; col++) {
+                int cell = row * iconGrid.cols + col;
+                int start = iconGrid.cellStart[cell];
+                int end = iconGrid.cellStart[cell + 1];
+
+                if(start == end) {
+                    continue;
+                }
+
+                if(abs(row - icon_row) <= 1 && abs(col - icon_col) <= 1) {
+                    for(int k = start; k < end; k++) {
+                        int j = iconGrid.items[k];
+
+                        if(j != i) {
+                            s.pressure[i] += 1.0f / ((s.cx[j] - s.cx[i]) * (s.cx[j] - s.cx[i]) + (s.cy[j] - s.cy[i]) * (s.cy[j] - s.cy[i]));
+                        }
+                    }
+                } else {
+                    float dx = iconGrid.cellX[cell] - s.cx[i];
+                    float dy = iconGrid.cellY[cell] - s.cy[i];
+
+                    s.pressure[i] += (float)(end - start) / (dx * dx + dy * dy);
+                }
+            }
+        }
 
-        //check against other labels
-        while(check_p) {
-            if(check_p->addr != p->addr) {
+        //check against other labels, any that can overlap have their top left
+        //corner within the label size of this one
 
-                int check_left = check_p->x - 5 * screen_uiscale;
-                int check_right = check_p->x + check_p->w + 5 * screen_uiscale;
-                int check_top = check_p->y - 5 * screen_uiscale; 
-                int check_bottom = check_p->y + check_p->h + 5 * screen_uiscale;
+        for(int row = labelGrid.row(p_top - maxH - 5 * screen_uiscale); row <= labelGrid.row(p_bottom + 5 * screen_uiscale); row++) {
+            int end = labelGrid.cellStart[row * labelGrid.cols + labelGrid.col(p_right + 5 * screen_uiscale) + 1];
 
+            for(int k = labelGrid.cellStart[row * labelGrid.cols + labelGrid.col(p_left - maxW - 5 * screen_uiscale)]; k < end; k++) {
+                int j = labelGrid.items[k];
 
-                p->pressure += 1.0f / ((check_p->cx - p->cx) * (check_p->cx - p->cx) + (check_p->cy - p->cy) * (check_p->cy - p->cy));
+                if(j == i) {
+                    continue;
+                }
 
+                int check_left = s.x[j] - 5 * screen_uiscale;
+                int check_right = s.x[j] + s.w[j] + 5 * screen_uiscale;
+                int check_top = s.y[j] - 5 * screen_uiscale; 
+                int check_bottom = s.y[j] + s.h[j] + 5 * screen_uiscale;
 
-                //if(check_left > (p_right + 10) || check_right < (p_left - 10)) {
                 if(check_left > p_right || check_right < p_left) {
-                    check_p = check_p -> next;
                     continue;
                 }
 
-                //if(check_top > (p_bottom + 10) || check_bottom < (p_top - 10)) {
                 if(check_top > p_bottom || check_bottom < p_top) {
-                    check_p = check_p -> next;
                     continue;
                 }
 
                 //left collision
                 if(check_left > p_left && check_left < p_right) {
-                    check_p->ddox -= label_force * (float)(check_left - p_right);   
+                    s.ddox[j] -= label_force * (float)(check_left - p_right);   
                 }
 
                 //right collision
                 if(check_right > p_left && check_right < p_right) {
-                    check_p->ddox -= label_force * (float)(check_right - p_left);   
+                    s.ddox[j] -= label_force * (float)(check_right - p_left);   
                 }
 
                 //top collision
                 if(check_top > p_top && check_top < p_bottom) {
-                    check_p->ddoy -= label_force * (float)(check_top - p_bottom);   
+                    s.ddoy[j] -= label_force * (float)(check_top - p_bottom);   
                 }
 
                 //bottom collision
                 if(check_bottom > p_top && check_bottom < p_bottom) {
-                    check_p->ddoy -= label_force * (float)(check_bottom - p_top);   
+                    s.ddoy[j] -= label_force * (float)(check_bottom - p_top);   
                 }    
             }
-            check_p = check_p -> next;
         }
 
-        check_p = appData->aircraftList.head;
-
         //check against plane icons (include self)
 
-        p_left = p->x - 5 * screen_uiscale;
-        p_right = p->x + 5 * screen_uiscale;
-        p_top = p->y - 5 * screen_uiscale;
-        p_bottom = p->y + 5 * screen_uiscale;
+        p_left = s.x[i] - 5 * screen_uiscale;
+        p_right = s.x[i] + 5 * screen_uiscale;
+        p_top = s.y[i] - 5 * screen_uiscale;
+        p_bottom = s.y[i] + 5 * screen_uiscale;
 
-        while(check_p) {
+        for(int row = labelGrid.row(p_top - maxH - 5 * screen_uiscale); row <= labelGrid.row(p_bottom + 5 * screen_uiscale); row++) {
+            int end = labelGrid.cellStart[row * labelGrid.cols + labelGrid.col(p_right + 5 * screen_uiscale) + 1];
 
-            int check_left = check_p->x - 5 * screen_uiscale;
-            int check_right = check_p->x + check_p->w + 5 * screen_uiscale;
-            int check_top = check_p->y - 5 * screen_uiscale; 
-            int check_bottom = check_p->y + check_p->h + 5 * screen_uiscale;
+            for(int k = labelGrid.cellStart[row * labelGrid.cols + labelGrid.col(p_left - maxW - 5 * screen_uiscale)]; k < end; k++) {
+                int j = labelGrid.items[k];
 
-            if(check_left > p_right || check_right < p_left) {
-                check_p = check_p -> next;
-                continue;
-            }
+                int check_left = s.x[j] - 5 * screen_uiscale;
+                int check_right = s.x[j] + s.w[j] + 5 * screen_uiscale;
+                int check_top = s.y[j] - 5 * screen_uiscale; 
+                int check_bottom = s.y[j] + s.h[j] + 5 * screen_uiscale;
 
-            if(check_top > p_bottom || check_bottom < p_top) {
-                check_p = check_p -> next;
-                continue;
-            }
+                if(check_left > p_right || check_right < p_left) {
+                    continue;
+                }
 
-            //left collision
-            if(check_left > p_left && check_left < p_right) {
-                check_p->ddox -= plane_force * (float)(check_left - p_right);   
-            }
+                if(check_top > p_bottom || check_bottom < p_top) {
+                    continue;
+                }
 
-            //right collision
-            if(check_right > p_left && check_right < p_right) {
-                check_p->ddox -= plane_force * (float)(check_right - p_left);   
-            }
+                //left collision
+                if(check_left > p_left && check_left < p_right) {
+                    s.ddox[j] -= plane_force * (float)(check_left - p_right);   
+                }
 
-            //top collision
-            if(check_top > p_top && check_top < p_bottom) {
-                check_p->ddoy -= plane_force * (float)(check_top - p_bottom);   
-            }
+                //right collision
+                if(check_right > p_left && check_right < p_right) {
+                    s.ddox[j] -= plane_force * (float)(check_right - p_left);   
+                }
 
-            //bottom collision
-            if(check_bottom > p_top && check_bottom < p_bottom) {
-                check_p->ddoy -= plane_force * (float)(check_bottom - p_top);   
-            }            
-        
-            check_p = check_p -> next;
-        }
+                //top collision
+                if(check_top > p_top && check_top < p_bottom) {
+                    s.ddoy[j] -= plane_force * (float)(check_top - p_bottom);   
+                }
 
-        p = p->next;
+                //bottom collision
+                if(check_bottom > p_top && check_bottom < p_bottom) {
+                    s.ddoy[j] -= plane_force * (float)(check_bottom - p_top);   
+                }            
+            }
+        }
     }
 
     //update 
 
-    p = appData->aircraftList.head;
+    labelsMoving = false;
 
-    while(p) {
-        p->dox += p->ddox;
-        p->doy += p->ddoy;
+    for(int i = 0; i < s.count; i++) {
+        s.dox[i] += s.ddox[i];
+        s.doy[i] += s.ddoy[i];
 
-        p->dox *= damping_force;
-        p->doy *= damping_force;
+        s.dox[i] *= damping_force;
+        s.doy[i] *= damping_force;
   
-        if(fabs(p->dox) > 10.0f) {
-            p->dox = sign(p->dox) * 10.0f;
+        if(fabs(s.dox[i]) > 10.0f) {
+            s.dox[i] = sign(s.dox[i]) * 10.0f;
         }
 
-        if(fabs(p->doy) > 10.0f) {
-            p->doy = sign(p->doy) * 10.0f;
+        if(fabs(s.doy[i]) > 10.0f) {
+            s.doy[i] = sign(s.doy[i]) * 10.0f;
         }
 
-        if(fabs(p->dox) < 1.0f) {
-            p->dox = 0;
+        if(fabs(s.dox[i]) < 1.0f) {
+            s.dox[i] = 0;
         }
 
-        if(fabs(p->doy) < 1.0f) {
-            p->doy = 0;
+        if(fabs(s.doy[i]) < 1.0f) {
+            s.doy[i] = 0;
         }
 
-        p->ox += p->dox;
-        p->oy += p->doy;
+        if(s.dox[i] || s.doy[i]) {
+            labelsMoving = true;
+        }
 
-        p->x = p->cx + (int)round(p->ox);
-        p->y = p->cy + (int)round(p->oy);
+        s.ox[i] += s.dox[i];
+        s.oy[i] += s.doy[i];
 
-        p = p->next;
+        s.x[i] = s.cx[i] + (int)round(s.ox[i]);
+        s.y[i] = s.cy[i] + (int)round(s.oy[i]);
     }
 }
 
 
-void View::drawPlanes() {
-    Aircraft *p = appData->aircraftList.head;
-    SDL_Color planeColor;
+//
+// --bench-labels: time the label solver, four passes a frame as in draw(),
+// on random scenes doubling up to n aircraft, to check it scales linearly
+//
+void View::labelBench(int n) {
+    AircraftSnapshot &s = snapshot;
+    int frames = 20;
+
+    srand(1);
+
+    for(int count = n < 250 ? n : 250; count > 0; count = (count < n && count * 2 > n) ? n : count * 2) {
+        s.resize(count);
+        s.count = count;
+
+        for(int i = 0; i < count; i++) {
+            s.handle[i] = AIRCRAFT_NONE;
+            s.cx[i] = rand() % screen_width;
+            s.cy[i] = rand() % screen_height;
+            s.x[i] = s.cx[i];
+            s.y[i] = s.cy[i];
+            s.w[i] = 60 * screen_uiscale;
+            s.h[i] = 36 * screen_uiscale;
+            s.ox[i] = 0;
+            s.oy[i] = 0;
+            s.dox[i] = 0;
+            s.doy[i] = 0;
+        }
 
-    if(selectedAircraft) {
-        mapTargetLon = selectedAircraft->lon;
-        mapTargetLat = selectedAircraft->lat;             
+        std::chrono::high_resolution_clock::time_point start = now();
+
+        for(int f = 0; f < frames; f++) {
+            for(int i = 0; i < 4; i++) {
+                resolveLabelConflicts();
+            }
+        }
+
+        float ms = elapsed(start) / frames;
+
+        printf("%6d aircraft %9.3f ms/frame %7.3f us/aircraft\n", count, ms, 1000.0f * ms / count);
+
+        if(count >= n) {
+            break;
+        }
     }
 
-    p = appData->aircraftList.head;
+    s.count = 0;
+}
 
-    while(p) {
-        if (p->lon && p->lat) {
-            int x, y;
+//
+// --bench-raster: time map rasters at the centre from street to country
+// scale, drawn on a software renderer by SDL2_gfx a segment at a time as
+// the map used to be and by SDL_RenderDrawLines a polyline at a time, and
+// by the tiled rasterizer on one thread and on the full pool
+//
+void View::rasterBench() {
+    int frames = 5;
+    int threads = MapRasterizer::defaultThreads();
+    float dists[] = {5, 25, 100, 400, 1600};
 
-            float dx, dy;
-            pxFromLonLat(&dx, &dy, p->lon, p->lat);
-            screenCoords(&x, &y, dx, dy);
+    mapTextureWidth = screen_width + 2 * (int) (MAP_OVERSCAN * screen_width);
+    mapTextureHeight = screen_height + 2 * (int) (MAP_OVERSCAN * screen_height);
 
-            float age_ms = elapsed(p->created);
-            if(age_ms < 500) {
-                float ratio = age_ms / 500.0f;
-                float radius = (1.0f - ratio * ratio) * screen_width / 8;
-                for(float theta = 0; theta < 2*M_PI; theta += M_PI / 4) {
-                    pixelRGBA(renderer, x + radius * cos(theta), y + radius * sin(theta), style.planeColor.r, style.planeColor.g, style.planeColor.b, 255 * ratio);
-                }
-                // circleRGBA(renderer, x, y, 500 - age_ms, 255,255, 255, (uint8_t)(255.0 * age_ms / 500.0));   
-            } else {
-                if(MODES_ACFLAGS_HEADING_VALID) {
-                    int usex = x;   
-                    int usey = y;
+    SDL_Surface *target = SDL_CreateRGBSurfaceWithFormat(0, mapTextureWidth, mapTextureHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer *soft = target ? SDL_CreateSoftwareRenderer(target) : NULL;
 
-                    //draw predicted position
-                    // if(p->timestampHistory.size() > 2) {
+    if(!soft) {
+        fprintf(stderr, "Couldn't create software renderer: %s\n", SDL_GetError());
+        return;
+    }
 
-                    //     int x1, y1, x2, y2;
+    MapRasterizer single;
+    MapRasterizer pool;
 
-                    //     pxFromLonLat(&dx, &dy, p->lonHistory.end()[-1], p->latHistory.end()[-1]);
-                    //     screenCoords(&x1, &y1, dx, dy);
-                        
-                    //     pxFromLonLat(&dx, &dy, p->lonHistory.end()[-2], p->latHistory.end()[-2]);
-                    //     screenCoords(&x2, &y2, dx, dy);
+    single.startPool(&map, 1);
+    pool.startPool(&map, threads);
 
-                    //     //printf("latlon: [%f %f] -> [%f %f], px: [%d %d] -> [%d  %d]\n",p->lonHistory.end()[-1], p->latHistory.end()[-1],p->lonHistory.end()[-2], p->latHistory.end()[-2], x1,y1,x2,y2);
+    std::vector<Uint32> singlePixels;
+    std::vector<Uint32> poolPixels;
+    std::vector<MapSegment> segments;
 
+    printf("%dx%d raster, %d threads\n", mapTextureWidth, mapTextureHeight, threads);
 
-                    //     float velx = float(x1 - x2) / (fmilliseconds{p->timestampHistory.end()[-1] - p->timestampHistory.end()[-2]}).count();
-                    //     float vely = float(y1 - y2) / (fmilliseconds{p->timestampHistory.end()[-1] - p->timestampHistory.end()[-2]}).count();
+    for(size_t d = 0; d < sizeof(dists) / sizeof(dists[0]); d++) {
+        MapRaster raster;
+        MapJob job = rasterJob(mapKey(dists[d], centerLat, centerLon, &raster), raster);
 
-                    //     //printf("diff: %f\n",(fmilliseconds{p->timestampHistory.end()[-1] - p->timestampHistory.end()[-2]}).count());
+        std::chrono::high_resolution_clock::time_point start = now();
 
-                    //     //printf("%f %f, %d - %d \n", velx,vely,p->timestampHistory.end()[-1], p->timestampHistory.end()[-2]);
+        for(int f = 0; f < frames; f++) {
+            single.project(job, segments);
 
-                    //     usex = x + float(elapsed(p->msSeenLatLon)) * velx;
-                    //     usey = y + float(elapsed(p->msSeenLatLon)) * vely;
-                    // }
+            SDL_SetRenderDrawColor(soft, style.backgroundColor.r, style.backgroundColor.g, style.backgroundColor.b, 255);
+            SDL_RenderClear(soft);
 
-                    planeColor = lerpColor(style.planeColor, style.planeGoneColor, float(elapsed_s(p->msSeen)) / (float) DISPLAY_ACTIVE);
-                    
-                    if(p == selectedAircraft) {
-                        planeColor = style.selectedColor;
-                    }
+            for(size_t i = 0; i < segments.size(); i++) {
+                lineRGBA(soft, segments[i].x1, segments[i].y1, segments[i].x2, segments[i].y2, style.mapInnerColor.r, style.mapInnerColor.g, style.mapInnerColor.b, 255);
+            }
+        }
 
-                    if(outOfBounds(x,y)) {
-                        drawPlaneOffMap(x, y, &(p->cx), &(p->cy), planeColor);
-                    } else {
-                        drawPlaneIcon(usex, usey, p->track, planeColor);
-                        p->cx = usex;
-                        p->cy = usey;
-                    }
-                      
-                    if(p != selectedAircraft) {
-                        //show latlon ping
-                        if(elapsed(p->msSeenLatLon) < 500) {
-                            circleRGBA(renderer, p->cx, p->cy, elapsed(p->msSeenLatLon) * screen_width / (8192), 127,127, 127, 255 - (uint8_t)(255.0 * elapsed(p->msSeenLatLon) / 500.0));   
-                        }
+        float gfxMs = elapsed(start) / frames;
 
-                        drawPlaneText(p);
-                    }
+        // connected segments as one SDL_RenderDrawLines call each
+        std::vector<SDL_Point> run;
+        int calls = 0;
+
+        start = now();
+
+        for(int f = 0; f < frames; f++) {
+            single.project(job, segments);
+
+            SDL_SetRenderDrawColor(soft, style.backgroundColor.r, style.backgroundColor.g, style.backgroundColor.b, 255);
+            SDL_RenderClear(soft);
+            SDL_SetRenderDrawColor(soft, style.mapInnerColor.r, style.mapInnerColor.g, style.mapInnerColor.b, 255);
+
+            calls = 0;
 
+            for(size_t i = 0; i < segments.size(); i++) {
+                if(run.empty()) {
+                    SDL_Point p = {segments[i].x1, segments[i].y1};
+                    run.push_back(p);
+                }
+
+                SDL_Point p = {segments[i].x2, segments[i].y2};
+                run.push_back(p);
+
+                if(i + 1 == segments.size() || segments[i + 1].x1 != p.x || segments[i + 1].y1 != p.y) {
+                    SDL_RenderDrawLines(soft, run.data(), run.size());
+                    run.clear();
+                    calls++;
                 }
             }
         }
-        p = p->next;
+
+        float linesMs = elapsed(start) / frames;
+
+        start = now();
+        for(int f = 0; f < frames; f++) {
+            single.render(job, singlePixels);
+        }
+        float singleMs = elapsed(start) / frames;
+
+        start = now();
+        for(int f = 0; f < frames; f++) {
+            pool.render(job, poolPixels);
+        }
+        float poolMs = elapsed(start) / frames;
+
+        bool same = singlePixels == poolPixels;
+
+        printf("%7.0f km level %d %8d segments  gfx %8.2f ms  polylines (%d calls) %8.2f ms  tiled x1 %8.2f ms  tiled x%d %8.2f ms %s\n",
+            dists[d], job.level, (int) segments.size(), gfxMs, calls, linesMs, singleMs, threads, poolMs, same ? "" : " MISMATCH");
     }
 
+    SDL_DestroyRenderer(soft);
+    SDL_FreeSurface(target);
+}
+
+void View::drawPlanes() {
+    int selectedAircraft = appData->aircraftList.selected;
+    AircraftSnapshot &s = snapshot;
+
+    if(selectedAircraft != AIRCRAFT_NONE) {
+        mapTargetLon = appData->aircraftList.hot(selectedAircraft)->lon;
+        mapTargetLat = appData->aircraftList.hot(selectedAircraft)->lat;             
+    }
+
+    for(int i = 0; i < s.count; i++) {
+        if(s.flags[i] & SNAP_NEW) {
+            float ratio = s.age[i] / 500.0f;
+            float radius = (1.0f - ratio * ratio) * screen_width / 8;
+            for(float theta = 0; theta < 2*M_PI; theta += M_PI / 4) {
+                pixelRGBA(renderer, s.sx[i] + radius * cos(theta), s.sy[i] + radius * sin(theta), style.planeColor.r, style.planeColor.g, style.planeColor.b, 255 * ratio);
+            }
+            continue;
+        }
+
+        SDL_Color planeColor = palette[s.color[i]];
+
+        if(s.flags[i] & SNAP_OFFMAP) {
+            drawPlaneOffMap(s.sx[i], s.sy[i], &s.cx[i], &s.cy[i], planeColor);
+        } else {
+            drawPlaneIcon(s.sx[i], s.sy[i], s.heading[i], planeColor);
+            s.cx[i] = s.sx[i];
+            s.cy[i] = s.sy[i];
+        }
+    }
+
+    //all the icons go in one batch, under the labels
+
+    iconBatch.flush(renderer);
+
+    for(int i = 0; i < s.count; i++) {
+        if(s.flags[i] & (SNAP_NEW | SNAP_SELECTED)) {
+            continue;
+        }
+
+        //show latlon ping
+        if(s.flags[i] & SNAP_PING) {
+            circleRGBA(renderer, s.cx[i], s.cy[i], s.ping[i] * screen_width / (8192), 127,127, 127, 255 - (uint8_t)(255.0 * s.ping[i] / 500.0));   
+        }
+
+        drawPlaneText(i);
+    }
+
+    commitSnapshot();
+
     drawSelectedAircraftText(selectedAircraft);    
 }
 
+//
+// Copy what the renderer needs out of the aircraft list. Positions are
+// projected for this frame; the label layout carries over from the last one.
+//
+void View::buildSnapshot() {
+    AircraftList &list = appData->aircraftList;
+    AircraftSnapshot &s = snapshot;
+    int n = 0;
+
+    for(int i = 0; i < SNAPSHOT_COLORS; i++) {
+        palette[i] = lerpColor(style.planeColor, style.planeGoneColor, (float)i / (float)(SNAPSHOT_COLORS - 1));
+    }
+    palette[SNAPSHOT_COLORS] = style.selectedColor;
+
+    for(int j = 0; j < list.count(); j++) {
+        struct aircraft *a = list.hot(list.handle(j));
+
+        if(!list.display(a->handle)->hidden && a->lon && a->lat) {
+            n++;
+        }
+    }
+
+    s.resize(n);
+
+    planesAnimating = false;
+    fadePending = false;
+
+    int i = 0;
+    for(int j = 0; j < list.count(); j++) {
+        struct aircraft *a = list.hot(list.handle(j));
+        Aircraft *p = list.display(a->handle);
+
+        if(p->hidden || !(a->lon && a->lat)) {
+            continue;
+        }
+
+        float dx, dy;
+        pxFromLonLat(&dx, &dy, a->lon, a->lat);
+        screenCoords(&s.sx[i], &s.sy[i], dx, dy);
+
+        s.handle[i] = a->handle;
+        s.addr[i] = a->addr;
+        s.heading[i] = a->track;
+        s.age[i] = elapsed(p->created);
+        s.ping[i] = elapsed(p->msSeenLatLon);
+
+        s.flags[i] = 0;
+        if(s.age[i] < 500) {
+            s.flags[i] |= SNAP_NEW;
+        }
+        if(s.ping[i] < 500) {
+            s.flags[i] |= SNAP_PING;
+        }
+        if(outOfBounds(s.sx[i], s.sy[i])) {
+            s.flags[i] |= SNAP_OFFMAP;
+        }
+
+        if(a->handle == list.selected) {
+            s.flags[i] |= SNAP_SELECTED;
+            s.color[i] = SNAPSHOT_COLORS;
+        } else if(a->flags & AIRCRAFT_FADED) {
+            s.color[i] = SNAPSHOT_COLORS - 1;
+        } else {
+            float fade = clamp(float(elapsed_s(p->msSeen)) / (float) DISPLAY_ACTIVE, 0, 1) * (SNAPSHOT_COLORS - 1);
+            s.color[i] = (uint8_t) round(fade);
+
+            // wake up again when this aircraft rounds to its next colour
+            if(s.color[i] < SNAPSHOT_COLORS - 1) {
+                int wait = (int) ceil((s.color[i] + 0.5f - fade) * 1000.0f * DISPLAY_ACTIVE / (SNAPSHOT_COLORS - 1));
+                std::chrono::high_resolution_clock::time_point due = now() + std::chrono::milliseconds(wait);
+
+                if(!fadePending || due < fadeDue) {
+                    fadeDue = due;
+                    fadePending = true;
+                }
+            }
+        }
+
+        if(s.age[i] < 500 || s.ping[i] < 1024 || elapsed(p->msSeen) < 1024) {
+            planesAnimating = true;
+        }
+
+        s.cx[i] = p->cx;
+        s.cy[i] = p->cy;
+        s.x[i] = p->x;
+        s.y[i] = p->y;
+        s.w[i] = p->w;
+        s.h[i] = p->h;
+        s.ox[i] = p->ox;
+        s.oy[i] = p->oy;
+        s.dox[i] = p->dox;
+        s.doy[i] = p->doy;
+        s.ddox[i] = p->ddox;
+        s.ddoy[i] = p->ddoy;
+        s.pressure[i] = p->pressure;
+
+        i++;
+    }
+
+    s.count = n;
+}
+
+//
+// Hand the label layout back to the aircraft so it survives to the next frame
+//
+void View::commitSnapshot() {
+    AircraftSnapshot &s = snapshot;
+
+    for(int i = 0; i < s.count; i++) {
+        Aircraft *p = appData->aircraftList.display(s.handle[i]);
+
+        p->cx = s.cx[i];
+        p->cy = s.cy[i];
+        p->x = s.x[i];
+        p->y = s.y[i];
+        p->w = s.w[i];
+        p->h = s.h[i];
+        p->ox = s.ox[i];
+        p->oy = s.oy[i];
+        p->dox = s.dox[i];
+        p->doy = s.doy[i];
+        p->ddox = s.ddox[i];
+        p->ddoy = s.ddoy[i];
+        p->pressure = s.pressure[i];
+    }
+}
+
+void AircraftSnapshot::resize(int n) {
+    handle.resize(n);
+    addr.resize(n);
+    sx.resize(n);
+    sy.resize(n);
+    cx.resize(n);
+    cy.resize(n);
+    heading.resize(n);
+    color.resize(n);
+    flags.resize(n);
+    age.resize(n);
+    ping.resize(n);
+    x.resize(n);
+    y.resize(n);
+    w.resize(n);
+    h.resize(n);
+    ox.resize(n);
+    oy.resize(n);
+    dox.resize(n);
+    doy.resize(n);
+    ddox.resize(n);
+    ddoy.resize(n);
+    pressure.resize(n);
+}
+
+//
+// Bucket count points into a width x height screen. The cells are counted,
+// turned into end offsets, then filled back to front so each ends up at its
+// start offset with the items in index order. Each cell's mean position is
+// kept for callers that treat a far cell as a single point.
+//
+void SpatialGrid::build(const int *x, const int *y, int count, int width, int height, int size) {
+    cellSize = size;
+    cols = width / size + 1;
+    rows = height / size + 1;
+
+    cellStart.assign(cols * rows + 1, 0);
+    items.resize(count);
+    itemCell.resize(count);
+
+    for(int i = 0; i < count; i++) {
+        itemCell[i] = row(y[i]) * cols + col(x[i]);
+        cellStart[itemCell[i]]++;
+    }
+
+    for(int c = 1; c <= cols * rows; c++) {
+        cellStart[c] += cellStart[c - 1];
+    }
+
+    for(int i = count - 1; i >= 0; i--) {
+        items[--cellStart[itemCell[i]]] = i;
+    }
+
+    cellX.assign(cols * rows, 0);
+    cellY.assign(cols * rows, 0);
+
+    for(int c = 0; c < cols * rows; c++) {
+        int n = cellStart[c + 1] - cellStart[c];
+
+        for(int k = cellStart[c]; k < cellStart[c + 1]; k++) {
+            cellX[c] += x[items[k]];
+            cellY[c] += y[items[k]];
+        }
+
+        if(n) {
+            cellX[c] /= n;
+            cellY[c] /= n;
+        }
+    }
+}
+
+int SpatialGrid::col(int x) const {
+    int c = x / cellSize;
+
+    return c < 0 ? 0 : (c >= cols ? cols - 1 : c);
+}
+
+int SpatialGrid::row(int y) const {
+    int r = y / cellSize;
+
+    return r < 0 ? 0 : (r >= rows ? rows - 1 : r);
+}
+
 void View::animateCenterAbsolute(float x, float y) {
     float scale_factor = (screen_width > screen_height) ? screen_width : screen_height;
 
@@ -1375,6 +2046,12 @@ void View::drawMouse() {
 }
 
 void View::drawClick() {
+    Aircraft *selectedAircraft = NULL;
+
+    if(appData->aircraftList.selected != AIRCRAFT_NONE) {
+        selectedAircraft = appData->aircraftList.display(appData->aircraftList.selected);
+    }
+
     if(clickx && clicky) {
 
         int radius = .25 * elapsed(clickTime);
@@ -1415,27 +2092,23 @@ void View::drawClick() {
 
 void View::registerClick(int tapcount, int x, int y) {
     if(tapcount == 1) {
-        Aircraft *p = appData->aircraftList.head;
-        Aircraft *selection = NULL;
-
-        while(p) {
-            if(x && y) {
-                if((p->cx - x) * (p->cx - x) + (p->cy - y) * (p->cy - y) < 900) {
-                    if(selection) {
-                        if((p->cx - x) * (p->cx - x) + (p->cy - y) * (p->cy - y) < 
-                            (selection->cx - x) * (selection->cx - x) + (selection->cy - y) * (selection->cy - y)) {
-                            selection = p;
-                        }
-                    } else {
-                        selection = p;
-                    }    
+        // Input is handled before the aircraft list is updated, so last
+        // frame's snapshot still only points at live aircraft
+        int selection = AIRCRAFT_NONE;
+        int selectionDist = 900;
+
+        if(x && y) {
+            for(int i = 0; i < snapshot.count; i++) {
+                int dist = (snapshot.cx[i] - x) * (snapshot.cx[i] - x) + (snapshot.cy[i] - y) * (snapshot.cy[i] - y);
+
+                if(dist < selectionDist) {
+                    selection = snapshot.handle[i];
+                    selectionDist = dist;
                 }
             }
-
-            p = p->next;
         }
 
-        selectedAircraft = selection;
+        appData->aircraftList.selected = selection;
     } else if(tapcount == 2) {
         mapTargetMaxDist = 0.25 * maxDist;
         animateCenterAbsolute(x, y);
@@ -1457,39 +2130,201 @@ void View::registerMouseMove(int x, int y) {
 // 
 //
 
+//
+// Anything still moving on screen without new input or data: map pans and
+// zooms, the map re-raster after a move, label settling, click feedback and
+// the new aircraft/ping/signal animations. Fading aircraft only need a frame
+// when one of them changes colour.
+//
+int View::needsDraw() {
+    if(dirty || mapMoved || mapRedraw || mapAnimating) {
+        return 1;
+    }
+
+    // the selected aircraft re-targets the map every frame, so only count
+    // targets that are still some way off
+    if(mapTargetMaxDist && fabs(mapTargetMaxDist - maxDist) > 0.0001) {
+        return 1;
+    }
+
+    if(mapTargetLon && mapTargetLat && (fabs(mapTargetLon - centerLon) > 0.0001 || fabs(mapTargetLat - centerLat) > 0.0001)) {
+        return 1;
+    }
+
+    if((clickx && clicky) || (appData->aircraftList.selected != AIRCRAFT_NONE && elapsed(clickTime) < 300)) {
+        return 1;
+    }
+
+    if(labelsMoving || planesAnimating || snapshotRequested) {
+        return 1;
+    }
+
+    if(snapshotInterval && elapsed(lastSnapshot) >= snapshotInterval) {
+        return 1;
+    }
+
+    return fadePending && now() >= fadeDue;
+}
+
+//
+// How long the main loop can sleep, in ms, before needsDraw() could change
+// on its own
+//
+int View::idleTimeout() {
+    int wait = 1000;
+
+    if(fadePending) {
+        wait = (int) std::chrono::duration_cast<std::chrono::milliseconds>(fadeDue - now()).count();
+    }
+
+    if(snapshotInterval && snapshotInterval - (int) elapsed(lastSnapshot) < wait) {
+        wait = snapshotInterval - (int) elapsed(lastSnapshot);
+    }
+
+    return (wait > 0) ? ((wait < 1000) ? wait : 1000) : 0;
+}
+
+//
+// Write a snapshot at the end of the next frame
+//
+void View::requestSnapshot() {
+    snapshotRequested = true;
+    dirty = 1;
+}
+
+//
+// Read back the frame just drawn, before it's presented, and write it out as
+// a PNG to snapshotPath
+//
+void View::writeSnapshot() {
+    std::vector<uint8_t> pixels(3 * screen_width * screen_height);
+
+    if(SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGB24, pixels.data(), 3 * screen_width) < 0) {
+        fprintf(stderr, "Couldn't read back frame for snapshot: %s\n", SDL_GetError());
+        return;
+    }
+
+    std::string path = snapshotPath;
+    size_t number = path.find("%d");
+    if(number != std::string::npos) {
+        path.replace(number, 2, std::to_string(snapshotCount));
+    }
+
+    FILE *f;
+    if(path == "-") {
+        f = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    } else {
+        f = fopen(path.c_str(), "wb");
+    }
+
+    if(!f) {
+        fprintf(stderr, "Couldn't open snapshot file %s\n", path.c_str());
+        return;
+    }
+
+    if(!writePng(f, pixels.data(), screen_width, screen_height, 3 * screen_width)) {
+        fprintf(stderr, "Couldn't write snapshot %s\n", path.c_str());
+    }
+
+    if(f == stdout) {
+        fflush(stdout);
+    } else {
+        fclose(f);
+    }
+
+    snapshotCount++;
+}
+
+//
+// Frame count and mean draw() time, for benchmarking headless runs
+//
+void View::printDrawStats() {
+    fprintf(stderr, "%d frames, %.2f ms/frame\n", drawCount, drawCount ? drawTimeTotal / drawCount : 0.0);
+}
+
 void View::draw() {
     drawStartTime = now();
+
+    dirty = 0;
+
+    textCache.newFrame();
+
+    iconBatch.calls = iconBatch.triangles = 0;
+    trailBatch.calls = trailBatch.triangles = 0;
     
-    moveMapToTarget();
-    zoomMapToTarget();
+    {
+        ProfileScope scope(PROFILE_MOVE);
+        moveMapToTarget();
+        zoomMapToTarget();
+    }
+
+    buildSnapshot();
 
-    for(int i = 0; i < 4; i++) {
-        resolveLabelConflicts();
+    {
+        ProfileScope scope(PROFILE_LABELS);
+        for(int i = 0; i < 4; i++) {
+            resolveLabelConflicts();
+        }
     }
 
     lineCount = 0;
 
-    drawGeography();
+    {
+        ProfileScope scope(PROFILE_GEOGRAPHY);
+        drawGeography();
+    }
+
     drawScaleBars();
-    drawPlanes();  
-    drawStatus();
+
+    {
+        ProfileScope scope(PROFILE_PLANES);
+        drawPlanes();  
+    }
+
+    {
+        ProfileScope scope(PROFILE_STATUS);
+        drawStatus();
+    }
+
+    if(showProfile) {
+        drawProfile();
+    }
+
     //drawMouse();
     drawClick();
 
     char fps[40] = " ";
     snprintf(fps,40," %d lines @ %.1ffps", lineCount, 1000.0 / elapsed(lastFrameTime));
-    drawStringBG(fps, 0,0, mapFont, grey, black);  
+    drawStringBG(fps, 0,0, &mapGlyphs, grey, black, false);  
+
+    if(snapshotRequested || (snapshotInterval && elapsed(lastSnapshot) >= snapshotInterval)) {
+        writeSnapshot();
+        snapshotRequested = false;
+        lastSnapshot = now();
+    }
+
+    {
+        ProfileScope scope(PROFILE_PRESENT);
+        SDL_RenderPresent(renderer);  
+    }
 
-    SDL_RenderPresent(renderer);  
+    profiler.endFrame();
 
-   if (elapsed(drawStartTime) < FRAMETIME) {
+    drawTimeTotal += std::chrono::duration<double, std::milli>(now() - drawStartTime).count();
+    drawCount++;
+
+    // nothing to pace against offscreen
+    if (!headless && elapsed(drawStartTime) < FRAMETIME) {
         std::this_thread::sleep_for(fmilliseconds{FRAMETIME} - (now() - drawStartTime));
     } 
 
     lastFrameTime = now(); 
 }
 
-View::View(AppData *appData){
+View::View(AppData *appData) : iconBatch(SDL_BLENDMODE_NONE), trailBatch(SDL_BLENDMODE_BLEND) {
     this->appData = appData;
 
     // Display options
@@ -1500,21 +2335,71 @@ View::View(AppData *appData){
     fullscreen              = 0;
     screen_index              = 0;
 
+    showProfile             = false;
+
+    headless                = 0;
+    window                  = NULL;
+    renderer                = NULL;
+    surface                 = NULL;
+    sdlStarted              = false;
+
+    // closed by ~View, which also runs after the benches that return
+    // before font_init()
+    mapFont                 = NULL;
+    mapBoldFont             = NULL;
+    messageFont             = NULL;
+    labelFont               = NULL;
+    listFont                = NULL;
+    snapshotPath            = "viz1090-%d.png";
+    snapshotInterval        = 0;
+    snapshotCount           = 0;
+    snapshotRequested       = false;
+    lastSnapshot            = now();
+    drawTimeTotal           = 0;
+    drawCount               = 0;
+
     maxDist                 = 25.0;
 
     mapMoved         = 1;
     mapRedraw        = 1;
+    mapAnimating     = 0;
+
+    dirty            = 1;
+    labelsMoving     = false;
+    planesAnimating  = false;
+    fadePending      = false;
+
+    snapshot.count   = 0;
 
-    selectedAircraft =  NULL;
+    rasterActive     = false;
+
+    style_init();
 }
 
 View::~View() {
+    rasterizer.stop();
+
+    textCache.clear();
+    mapCache.clear();
+
+    mapGlyphs.destroy();
+    mapBoldGlyphs.destroy();
+    messageGlyphs.destroy();
+    labelGlyphs.destroy();
+
     closeFont(mapFont);
     closeFont(mapBoldFont);
     closeFont(messageFont);
     closeFont(labelFont);
     closeFont(listFont);
 
-    TTF_Quit();
-    SDL_Quit();
+    if(surface) {
+        SDL_DestroyRenderer(renderer);
+        SDL_FreeSurface(surface);
+    }
+
+    if(sdlStarted) {
+        TTF_Quit();
+        SDL_Quit();
+    }
 }
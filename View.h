@@ -34,10 +34,16 @@
 
 #include "AppData.h"
 #include "Map.h"
+#include "GlyphAtlas.h"
+#include "TextCache.h"
+#include "GeometryBatch.h"
+#include "MapCache.h"
+#include "MapRasterizer.h"
 #include "SDL2/SDL.h"
 #include "SDL2/SDL_ttf.h" 
 #include <chrono>
 #include <string>
+#include <vector>
 
 //defs - should all move to config file setup
 #define ROUND_RADIUS 3 //radius of text box corners
@@ -46,7 +52,7 @@
 
 #define TRAIL_LENGTH 120
 #define TRAIL_TTL   240.0 
-#define DISPLAY_ACTIVE   30 
+#define DISPLAY_ACTIVE   MODES_INTERACTIVE_FADE_TTL
 #define TRAIL_TTL_STEP   2
 
 #define MIN_MAP_FEATURE 2
@@ -55,7 +61,20 @@
 
 #define PAD 5
 
-#define LATLONMULT 111.195 // 6371.0 * M_PI / 180.0
+#define MAP_OVERSCAN 0.25					//map texture margin on each side, as a fraction of the screen
+#define MAP_ZOOM_STEPS 8						//map raster zoom levels per doubling of maxDist
+#define MAP_CELL 0.25							//map raster centre grid, as a fraction of maxDist
+
+#define SNAPSHOT_COLORS 32 //steps in the plane fade palette, selected colour goes after them
+
+#define LABEL_CELL 64 //label grid cell size before ui scaling
+#define LABEL_PRESSURE_CELL 128 //plane grid cell size, planes beyond the neighbouring cells count by cell
+
+//snapshot flags
+#define SNAP_SELECTED 1
+#define SNAP_NEW      2 //still in the appear animation
+#define SNAP_PING     4 //position update in the last 500ms
+#define SNAP_OFFMAP   8
 
 
 
@@ -77,6 +96,52 @@ typedef struct Style {
     SDL_Color buttonColor;
 } Style;
 
+//
+// Per frame copy of the aircraft with a position, one array per field. The
+// label, draw and hit test passes scan these instead of walking
+// Aircraft::next through the full display records. Label state is copied
+// back to the Aircraft once the frame is drawn.
+//
+typedef struct AircraftSnapshot {
+    int count;
+
+    std::vector<int>        handle;     //aircraft store handle
+    std::vector<uint32_t>   addr;
+    std::vector<int>        sx, sy;     //projected position
+    std::vector<int>        cx, cy;     //icon position, pinned to the screen edge when off the map
+    std::vector<float>      heading;
+    std::vector<uint8_t>    color;      //index into View::palette
+    std::vector<uint8_t>    flags;
+    std::vector<float>      age;        //ms since the aircraft appeared
+    std::vector<float>      ping;       //ms since the last position
+
+    //label box and physics
+    std::vector<int>        x, y, w, h;
+    std::vector<float>      ox, oy, dox, doy, ddox, ddoy, pressure;
+
+    void resize(int n);
+} AircraftSnapshot;
+
+//
+// Screen space uniform grid over snapshot entries. Entries are counting
+// sorted by cell, so the cells along one row of a query are a single
+// contiguous run of items. Anything off the screen lands in an edge cell.
+//
+typedef struct SpatialGrid {
+    int cellSize;
+    int cols, rows;
+
+    std::vector<int> cellStart; //first item of each cell, plus the item count
+    std::vector<int> items;     //snapshot indices grouped by cell
+    std::vector<int> itemCell;  //cell of each snapshot index
+    std::vector<float> cellX;   //mean position of the items in each cell
+    std::vector<float> cellY;
+
+    void build(const int *x, const int *y, int count, int width, int height, int size);
+    int col(int x) const;
+    int row(int y) const;
+} SpatialGrid;
+
 
 
 class View {
@@ -102,15 +167,60 @@ class View {
 
 	    TTF_Font* loadFont(const char *name, int size);
 	    void closeFont(TTF_Font *font);
-		void drawString(std::string text, int x, int y, TTF_Font *font, SDL_Color color);
-		void drawStringBG(std::string text, int x, int y, TTF_Font *font, SDL_Color color, SDL_Color bgColor);
-		void drawStatusBox(int *left, int *top, std::string label, std::string message, SDL_Color color);
+		void drawString(std::string text, int x, int y, GlyphAtlas *glyphs, SDL_Color color);
+		void drawStringBG(std::string text, int x, int y, GlyphAtlas *glyphs, SDL_Color color, SDL_Color bgColor, bool cache = true);
+		void drawStatusBox(int *left, int *top, std::string label, std::string message, SDL_Color color, bool cache = true);
 		void drawStatus();
+		void drawProfile();
 
-		Aircraft *selectedAircraft;
 
 		Style style;
 
+		AircraftSnapshot snapshot;
+		SpatialGrid labelGrid;		//snapshot labels by top left corner
+		SpatialGrid iconGrid;		//snapshot plane icons, coarser, for label pressure
+		SDL_Color palette[SNAPSHOT_COLORS + 1];
+
+		GeometryBatch iconBatch;	//plane icons and off map arrows, opaque
+		GeometryBatch trailBatch;	//trails, alpha blended
+
+		void buildSnapshot();
+		void commitSnapshot();
+
+		MapCache mapCache;
+		MapRasterizer rasterizer;
+		MapKey rasterKey;				//last raster asked for
+		bool rasterActive;
+		Uint32 rasterEvent;
+		std::vector<Uint32> rasterPixels;
+		int mapTextureWidth;
+		int mapTextureHeight;
+
+		void sizeMapTextures();
+		void startRasterizer();
+		MapKey mapKey(float maxDist, float lat, float lon, MapRaster *raster);
+		void rasterDest(const MapRaster &raster, SDL_Rect *dest);
+		int coversScreen(SDL_Rect *dest);
+		void pickRasters(MapCache::Entry **base, MapCache::Entry **under, float *alpha);
+		void requestRaster(const MapKey &key, const MapRaster &raster);
+		MapJob rasterJob(const MapKey &key, const MapRaster &raster);
+		void collectRaster();
+
+		SDL_Surface *surface;	//headless render target
+		bool sdlStarted;		//SDL_init() ran; the benches return before it
+		int snapshotCount;
+		bool snapshotRequested;
+	    std::chrono::high_resolution_clock::time_point lastSnapshot;
+		double drawTimeTotal;	//ms spent in draw(), not counting the frame pacing sleep
+		int drawCount;
+
+		void writeSnapshot();
+
+		bool labelsMoving;		//label solver hasn't settled yet
+		bool planesAnimating;	//new aircraft or position pings still fading
+		bool fadePending;		//some aircraft will step to the next palette colour at fadeDue
+	    std::chrono::high_resolution_clock::time_point fadeDue;
+
 	public:
 		int screenDist(float d);
 		void pxFromLonLat(float *dx, float *dy, float lon, float lat);
@@ -122,13 +232,13 @@ class View {
 		void drawPlaneIcon(int x, int y, float heading, SDL_Color planeColor);
 		void drawTrails(int left, int top, int right, int bottom);
 		void drawScaleBars();
-		void drawLinesRecursive(QuadTree *tree, float screen_lat_min, float screen_lat_max, float screen_lon_min, float screen_lon_max);
-		void drawLines(int left, int top, int right, int bottom, int bailTime);
 		void drawGeography();
-		void drawSignalMarks(Aircraft *p, int x, int y);
-		void drawPlaneText(Aircraft *p);
-		void drawSelectedAircraftText(Aircraft *p);
+		void drawSignalMarks(int h, int x, int y);
+		void drawPlaneText(int i);
+		void drawSelectedAircraftText(int h);
 		void resolveLabelConflicts();
+		void labelBench(int n);
+		void rasterBench();
 		void drawPlanes();
 		void animateCenterAbsolute(float x, float y);
 		void moveCenterAbsolute(float x, float y);
@@ -140,9 +250,16 @@ class View {
 		void registerClick(int tapcount, int x, int y);
 		void registerMouseMove(int x, int y);
 		void draw();
+		int needsDraw();
+		int idleTimeout();
+		bool rasterPending();
+		void requestSnapshot();
+		void printDrawStats();
 		
 		void SDL_init();
 		void font_init();
+		void style_init();
+		bool buildGlyphs();
 
 		View(AppData *appData);
 		~View();
@@ -152,7 +269,6 @@ class View {
 		bool metric;
 
 	    float maxDist;
-	    float currentMaxDist;
 
 	    float centerLon;
 	    float centerLat;
@@ -165,14 +281,15 @@ class View {
 	    int mapRedraw;
 	    int mapAnimating;
 
-	    float currentLon;
-	    float currentLat;
+	    int dirty;		//input or new data since the last draw
+
 	    std::chrono::high_resolution_clock::time_point lastFrameTime;
 		std::chrono::high_resolution_clock::time_point drawStartTime;
-		std::chrono::high_resolution_clock::time_point lastRedraw;
 
 	    Map map;
 
+	    TextCache textCache;	//labels and status text
+
 	    int screen_upscale;
 	    int screen_uiscale;
 	    int screen_width;
@@ -181,9 +298,14 @@ class View {
 	    int fullscreen;
 	    int screen_index;
 
+	    bool showProfile;			//frame profiler overlay
+
+	    int headless;				//render offscreen, no window or display needed
+	    const char *snapshotPath;	//PNG snapshot file, "-" for stdout, first %d is the snapshot number
+	    int snapshotInterval;		//ms between snapshots, 0 for on demand only
+
 		SDL_Window		*window;
 		SDL_Renderer	*renderer;
-		SDL_Texture 	*mapTexture;
 
 		TTF_Font		*mapFont;
 		TTF_Font		*mapBoldFont;	
@@ -192,6 +314,11 @@ class View {
 		TTF_Font		*messageFont;	
 		TTF_Font		*labelFont;		
 
+		GlyphAtlas		mapGlyphs;
+		GlyphAtlas		mapBoldGlyphs;
+		GlyphAtlas		messageGlyphs;
+		GlyphAtlas		labelGlyphs;
+
 		int mapFontWidth;
 		int mapFontHeight;
 		int labelFontWidth;
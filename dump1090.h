@@ -65,6 +65,10 @@
     #include "anet.h"
 #endif
 
+#include <stddef.h>
+#include "timerwheel.h"
+#include "pool.h"
+
 // ============================= #defines ===============================
 //
 // If you have a valid coaa.h, these values will come from it. If not,
@@ -104,6 +108,11 @@
 #define MODEAC_MSG_MODEA_ONLY    (1<<4)
 #define MODEAC_MSG_MODEC_OLD     (1<<5)
 
+#define MODEAC_MODEA_BUCKETS      4096                        // One per octal squawk 0000..7777
+#define MODEAC_MODEC_MIN         -12                          // Lowest Mode C altitude, -1200 ft
+#define MODEAC_MODEC_MAX          1267                        // Highest Mode C altitude, 126700 ft
+#define MODEAC_MODEC_BUCKETS     (MODEAC_MODEC_MAX - MODEAC_MODEC_MIN + 1)
+
 #define MODES_PREAMBLE_US        8              // microseconds = bits
 #define MODES_PREAMBLE_SAMPLES  (MODES_PREAMBLE_US       * 2)
 #define MODES_PREAMBLE_SIZE     (MODES_PREAMBLE_SAMPLES  * sizeof(uint16_t))
@@ -148,6 +157,28 @@
 #define MODES_ACFLAGS_LLBOTH_VALID   (MODES_ACFLAGS_LLEVEN_VALID | MODES_ACFLAGS_LLODD_VALID)
 #define MODES_ACFLAGS_AOG_GROUND     (MODES_ACFLAGS_AOG_VALID    | MODES_ACFLAGS_AOG)
 
+#define MODES_COMMB_RING             4       // Raw Comm-B MB fields kept per aircraft
+#define MODES_COMMB_MB_BYTES         7       // 56 bit MB field of DF20/21
+
+#define AIRCRAFT_NONE                POOL_NONE // No aircraft handle
+
+#define AIRCRAFT_FADED               (1<<0)  // Nothing heard for interactive_fade_ttl
+#define AIRCRAFT_IN_MODEA            (1<<1)  // Linked into Modes.modeAIndex
+#define AIRCRAFT_IN_MODEC            (1<<2)  // Linked into Modes.modeCIndex
+
+#define COMMB_BDS20_VALID            (1<<0)  // Aircraft identification
+#define COMMB_BDS40_MCP_VALID        (1<<1)  // Selected altitude, MCP/FCU
+#define COMMB_BDS40_FMS_VALID        (1<<2)  // Selected altitude, FMS
+#define COMMB_BDS40_BARO_VALID       (1<<3)  // Barometric pressure setting
+#define COMMB_BDS50_ROLL_VALID       (1<<4)  // Roll angle
+#define COMMB_BDS50_TRACK_VALID      (1<<5)  // True track angle
+#define COMMB_BDS50_GS_VALID         (1<<6)  // Ground speed
+#define COMMB_BDS50_TAS_VALID        (1<<7)  // True airspeed
+#define COMMB_BDS60_HDG_VALID        (1<<8)  // Magnetic heading
+#define COMMB_BDS60_IAS_VALID        (1<<9)  // Indicated airspeed
+#define COMMB_BDS60_MACH_VALID       (1<<10) // Mach number
+#define COMMB_BDS60_VR_VALID         (1<<11) // Barometric vertical rate
+
 #define MODES_DEBUG_DEMOD (1<<0)
 #define MODES_DEBUG_DEMODERR (1<<1)
 #define MODES_DEBUG_BADCRC (1<<2)
@@ -164,6 +195,8 @@
 #define MODES_INTERACTIVE_ROWS          22      // Rows on screen
 #define MODES_INTERACTIVE_DELETE_TTL   300      // Delete from the list after 300 seconds
 #define MODES_INTERACTIVE_DISPLAY_TTL   60      // Delete from display after 60 seconds
+#define MODES_INTERACTIVE_FADE_TTL      30      // Shown as gone after 30 seconds
+#define MODES_DF_RING_SIZE            4096      // DF log entries, must be a power of two
 
 #define MODES_NET_HEARTBEAT_RATE       900      // Each block is approx 65mS - default is > 1 min
 
@@ -195,26 +228,37 @@ struct client {
     char   buf[MODES_CLIENT_BUF_SIZE+1]; // Read buffer
 };
 
-// Structure used to describe an aircraft in iteractive mode
+// Structure used to describe an aircraft in iteractive mode. These are the
+// fields the decoder touches for every message; everything else about the
+// aircraft lives in the parallel struct aircraftCold and display records of
+// the same handle, see struct aircraftStore.
 struct aircraft {
     uint32_t      addr;           // ICAO address
-    char          flight[16];     // Flight number
+    int           handle;         // Our index in Modes.aircraftStore
+    int           link;           // Position in aircraftStore.live, or the next free handle
     unsigned char signalLevel[8]; // Last 8 Signal Amplitudes
+    unsigned char flags;          // AIRCRAFT_xxx flags
     int           altitude;       // Altitude
     int           speed;          // Velocity
     int           track;          // Angle of flight
     int           vert_rate;      // Vertical rate.
     time_t        seen;           // Time at which the last packet was received
     time_t        seenLatLon;     // Time at which the last lat long was calculated
-    uint64_t      timestamp;      // Timestamp at which the last packet was received
-    uint64_t      timestampLatLon;// Timestamp at which the last lat long was calculated
-    long          messages;       // Number of Mode S messages received
+    int           messages;       // Number of Mode S messages received
     int           modeA;          // Squawk
     int           modeC;          // Altitude
-    long          modeAcount;     // Mode A Squawk hit Count
-    long          modeCcount;     // Mode C Altitude hit Count
+    int           modeAcount;     // Mode A Squawk hit Count
+    int           modeCcount;     // Mode C Altitude hit Count
     int           modeACflags;    // Flags for mode A/C recognition
 
+    // Mode S aircraft are chained into the squawk and altitude band indexes
+    // in Modes so that Mode A/C replies can be correlated with them. Links
+    // are handles, AIRCRAFT_NONE at either end of a chain.
+    int           modeANext, modeAPrev;
+    int           modeCNext, modeCPrev;
+
+    struct timerNode expiry;      // Fires when the aircraft is due to fade or be deleted
+
     // Encoded latitude and longitude as extracted by odd and even CPR encoded messages
     int           odd_cprlat;
     int           odd_cprlon;
@@ -224,16 +268,68 @@ struct aircraft {
     uint64_t      even_cprtime;
     double        lat, lon;       // Coordinated obtained from CPR encoded data
     int           bFlags;         // Flags related to valid fields in this structure
-    struct aircraft *next;        // Next aircraft in our linked list
+};
+
+// The parts of an aircraft that are only written by some messages and only
+// read by the display
+struct aircraftCold {
+    char          flight[16];     // Flight number
+
+    // Raw MB fields of the last few DF20/21 replies. These are only decoded
+    // on demand by decodeCommB(), as telling the BDS registers apart is
+    // guesswork that isn't worth doing for every reply.
+    unsigned char commB[MODES_COMMB_RING][MODES_COMMB_MB_BYTES];
+    unsigned int  commBCount;     // Number of MB fields received so far
+    time_t        commBSeen[MODES_COMMB_RING];
+
+    uint64_t      lastDF;         // Sequence number + 1 of our latest entry in Modes.dfRing, 0 if none
+};
+
+//
+// Every aircraft is one handle into the store's record pool, so handles and
+// pointers stay valid until the aircraft is removed. A pool slab holds the
+// hot records, then the cold ones, then displaySize bytes per aircraft owned
+// by the display through the aircraftCreated/aircraftRemoved hooks. Free
+// records are linked through struct aircraft.link.
+//
+struct aircraftChunk {
+    struct aircraft     hot [POOL_SLAB];
+    struct aircraftCold cold[POOL_SLAB];
+};
+
+struct aircraftStore {
+    struct pool            pool;        // Live, free and high water counts are kept here
+    size_t                 displaySize; // Display record size, fixed once the first slab exists
+    int                   *live;        // Handles of the live aircraft, in no particular order
+    int                   *hash;        // ICAO address -> handle, open addressed
+    unsigned int           hashMask;    // Size of hash - 1
+};
+
+#define aircraftSlab(s, h)    ((struct aircraftChunk *) poolSlab(&(s)->pool, h))
+#define aircraftHot(s, h)     (&aircraftSlab(s, h)->hot [poolSlot(h)])
+#define aircraftCold(s, h)    (&aircraftSlab(s, h)->cold[poolSlot(h)])
+#define aircraftDisplay(s, h) ((void *) ((unsigned char *) (aircraftSlab(s, h) + 1) + poolSlot(h) * (s)->displaySize))
+
+// Comm-B registers inferred by decodeCommB()
+struct commB {
+    int   valid;                  // COMMB_xxx_VALID flags for the fields below
+    char  flight[9];              // BDS 2,0
+    int   selAltMCP, selAltFMS;   // BDS 4,0 feet
+    float baro;                   // BDS 4,0 millibars
+    float roll, track;            // BDS 5,0 degrees
+    int   gs, tas;                // BDS 5,0 knots
+    float heading;                // BDS 6,0 degrees magnetic
+    int   ias;                    // BDS 6,0 knots
+    float mach;                   // BDS 6,0
+    int   vertRate;               // BDS 6,0 feet per minute
 };
 
 typedef struct stDF {
-    struct stDF     *pNext;                      // Pointer to next item in the linked list
-    struct stDF     *pPrev;                      // Pointer to previous item in the linked list
-    struct aircraft *pAircraft;                  // Pointer to the Aircraft structure for this DF
+    uint64_t         seq;                        // Sequence number + 1 of the DF in this slot, 0 while it is being written
+    uint64_t         prevSeq;                    // Sequence number + 1 of the previous DF from the same aircraft, 0 if none
     time_t           seen;                       // Dos/UNIX Time at which the this packet was received
     uint64_t         llTimestamp;                // Timestamp at which the this packet was received
-    uint32_t         addr;                       // Timestamp at which the this packet was received
+    uint32_t         addr;                       // ICAO address of the sender
     unsigned char    msg[MODES_LONG_MSG_BYTES];  // the binary
 } tDF;
 
@@ -312,6 +408,7 @@ typedef struct Modes{                             // Internal state
     int   interactive;               // Interactive mode
     int   interactive_rows;          // Interactive mode: max number of rows
     int   interactive_display_ttl;   // Interactive mode: TTL display
+    int   interactive_fade_ttl;      // Interactive mode: TTL before an aircraft is shown as gone
     int   interactive_delete_ttl;    // Interactive mode: TTL before deletion
     int   stats;                     // Print stats at exit in --ifile mode
     int   onlyaddr;                  // Print only ICAO addresses
@@ -325,14 +422,26 @@ typedef struct Modes{                             // Internal state
     int    bUserFlags;              // Flags relating to the user details
 
     // Interactive mode
-    struct aircraft *aircrafts;
+    struct aircraftStore aircraftStore;
+    struct timerWheel expiry;                 // Aircraft fade and delete timers
+    void           (*aircraftCreated)(void *ctx, int handle); // Called after an aircraft is added
+    void           (*aircraftRemoved)(void *ctx, int handle); // Called before an aircraft is freed
+    void            *aircraftHookCtx;
+    int              modeAIndex[MODEAC_MODEA_BUCKETS]; // Mode S aircraft handles by squawk
+    int              modeCIndex[MODEAC_MODEC_BUCKETS]; // Mode S aircraft handles by 100 ft altitude band
     uint64_t         interactive_last_update; // Last screen update in milliseconds
     time_t           last_cleanup_time;       // Last cleanup time in seconds
 
+    // Batch clock, sampled once per read batch by modesUpdateClock() so that
+    // every message decoded from the same batch sees the same time
+    uint64_t         clock_mono_ns;           // Monotonic time in nanoseconds
+    uint64_t         clock_mono_ms;           // Monotonic time in milliseconds
+    time_t           clock_now;               // Wall clock time in seconds
+
     // DF List mode
     int             bEnableDFLogging; // Set to enable DF Logging
-    pthread_mutex_t pDF_mutex;        // Mutex to synchronize pDF access
-    struct stDF    *pDF;              // Pointer to DF list
+    struct stDF    *dfRing;           // The last MODES_DF_RING_SIZE DF's, oldest get overwritten
+    uint64_t        dfHead;           // Sequence number of the next DF to be logged
 
     // Statistics
     unsigned int stat_valid_preamble;
@@ -428,29 +537,37 @@ extern "C" {
 // Functions exported from mode_ac.c
 //
 int  detectModeA       (uint16_t *m, struct modesMessage *mm);
-//void decodeModeAMessage(Modes *modes, struct modesMessage *mm, int ModeA);
+void decodeModeAMessage(struct modesMessage *mm, int ModeA);
 int  ModeAToModeC      (unsigned int ModeA);
 
 //
 // Functions exported from mode_s.c
 //
-void detectModeS        (uint16_t *m, uint32_t mlen);
+void detectModeS        (Modes *modes, uint16_t *m, uint32_t mlen);
 void decodeModesMessage (Modes *modes, struct modesMessage *mm, unsigned char *msg);
 void displayModesMessage(struct modesMessage *mm);
 void useModesMessage    (Modes* modes, struct modesMessage *mm);
-void computeMagnitudeVector(uint16_t *pData);
+void computeMagnitudeVector(Modes *modes, uint16_t *pData);
 int  decodeCPR          (Modes *modes, struct aircraft *a, int fflag, int surface);
 int  decodeCPRrelative  (Modes *modes, struct aircraft *a, int fflag, int surface);
 void modesInitErrorInfo (Modes *modes);
+void modesInitDemod     (Modes *modes);
+void applyPhaseCorrection(uint16_t *pPayload);
+typedef void (*magnitudeFn)(Modes *modes, const uint16_t *p, uint16_t *m, uint32_t n);
+int  magnitudeKernels   (magnitudeFn *kernels, const char **names, int max);
+int  decodeCommB        (struct aircraft *a, struct aircraftCold *c, struct commB *cb);
 //
 // Functions exported from interactive.c
 //
+void  modesUpdateClock   (Modes *modes);
+void  interactiveInit    (Modes *modes);
 struct aircraft* interactiveReceiveData(Modes *modes, struct modesMessage *mm);
 void  interactiveShowData(void);
 void  interactiveRemoveStaleAircrafts(Modes *modes);
+void  interactiveUpdateAircraftModeS (Modes *modes);
 int   decodeBinMessage   (Modes *modes, struct client *c, char *p);
-// struct aircraft *interactiveFindAircraft(uint32_t addr);
-struct stDF     *interactiveFindDF      (uint32_t addr);
+int   interactiveFindAircraft(Modes *modes, uint32_t addr);
+int   interactiveFindDF  (Modes *modes, int handle, struct stDF *out, int max);
 
 //
 // Functions exported from net_io.c
@@ -32,108 +32,413 @@
 //
 // ============================= Utility functions ==========================
 //
-static uint64_t mstime(void) {
-    struct timeval tv;
-    uint64_t mst;
-
-    gettimeofday(&tv, NULL);
-    mst = ((uint64_t)tv.tv_sec)*1000;
-    mst += tv.tv_usec/1000;
-    return mst;
+// Sample the clock once for a batch of messages. Everything decoded from the
+// batch reads modes->clock_* instead of calling time() or gettimeofday() per
+// message, so timestamps are consistent within a batch.
+//
+void modesUpdateClock(Modes *modes) {
+#ifndef _WIN32
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    modes->clock_mono_ns = ((uint64_t)ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    LARGE_INTEGER count, freq;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    modes->clock_mono_ns = (uint64_t) ((double) count.QuadPart * 1e9 / (double) freq.QuadPart);
+#endif
+    modes->clock_mono_ms = modes->clock_mono_ns / 1000000;
+    modes->clock_now     = time(NULL);
 }
 //
 //=========================================================================
 //
-// Add a new DF structure to the interactive mode linked list
+// Set up the aircraft store, the Mode A/C indexes and the DF log. The DF
+// log is a fixed ring, so it costs the same however busy the sky is.
 //
-void interactiveCreateDF(Modes *modes, struct aircraft *a, struct modesMessage *mm) {
-    struct stDF *pDF = (struct stDF *) malloc(sizeof(*pDF));
-
-    if (pDF) {
-        // Default everything to zero/NULL
-        memset(pDF, 0, sizeof(*pDF));
-
-        // Now initialise things
-        pDF->seen        = a->seen;
-        pDF->llTimestamp = mm->timestampMsg;
-        pDF->addr        = mm->addr;
-        pDF->pAircraft   = a;
-        memcpy(pDF->msg, mm->msg, MODES_LONG_MSG_BYTES);
-
-        // if (!pthread_mutex_lock(&modes->pDF_mutex)) {
-        //     if ((pDF->pNext = modes->pDF)) {
-        //         modes->pDF->pPrev = pDF;
-        //     }
-        //     modes->pDF = pDF;
-        //     pthread_mutex_unlock(&modes->pDF_mutex);
-        // } else {
-        //     free(pDF);
-        // }
-        if ((pDF->pNext = modes->pDF)) {
-            modes->pDF->pPrev = pDF;
+void interactiveInit(Modes *modes) {
+    int j;
+
+    memset(&modes->aircraftStore, 0, sizeof(modes->aircraftStore));
+    poolInit(&modes->aircraftStore.pool, "aircraft", sizeof(struct aircraftChunk),
+             offsetof(struct aircraftChunk, hot) + offsetof(struct aircraft, link), sizeof(struct aircraft));
+    timerWheelInit(&modes->expiry, modes->clock_now);
+
+    for (j = 0; j < MODEAC_MODEA_BUCKETS; j++) {modes->modeAIndex[j] = AIRCRAFT_NONE;}
+    for (j = 0; j < MODEAC_MODEC_BUCKETS; j++) {modes->modeCIndex[j] = AIRCRAFT_NONE;}
+
+    modes->dfHead = 0;
+    if (modes->bEnableDFLogging) {
+        modes->dfRing = (struct stDF *) calloc(MODES_DF_RING_SIZE, sizeof(struct stDF));
+        if (!modes->dfRing) {
+            fprintf(stderr, "Out of memory allocating the DF log.\n");
+            modes->bEnableDFLogging = 0;
         }
-        modes->pDF = pDF;
+    }
+}
+//
+//========================= Aircraft store =================================
+//
+// Aircraft come and go all day, so their records are recycled through the
+// store's pool rather than malloc'd and freed one by one. Lookups by
+// ICAO address go through an open addressed hash of handles kept at most
+// half full.
+//
+static unsigned int aircraftHashSlot(struct aircraftStore *s, uint32_t addr) {
+    return (addr * 2654435761U) & s->hashMask;
+}
 
+static void aircraftHashInsert(struct aircraftStore *s, int handle) {
+    unsigned int i = aircraftHashSlot(s, aircraftHot(s, handle)->addr);
+
+    while (s->hash[i] != AIRCRAFT_NONE) {i = (i + 1) & s->hashMask;}
+    s->hash[i] = handle;
+}
+
+static void aircraftHashRemove(struct aircraftStore *s, int handle) {
+    unsigned int i = aircraftHashSlot(s, aircraftHot(s, handle)->addr);
+    unsigned int j;
+
+    while (s->hash[i] != handle) {i = (i + 1) & s->hashMask;}
+
+    // Shift back any later entry of the run that would no longer be found
+    // past the hole, so lookups never need tombstones
+    for (j = (i + 1) & s->hashMask; s->hash[j] != AIRCRAFT_NONE; j = (j + 1) & s->hashMask) {
+        unsigned int want = aircraftHashSlot(s, aircraftHot(s, s->hash[j])->addr);
+
+        if (((j - want) & s->hashMask) >= ((j - i) & s->hashMask)) {
+            s->hash[i] = s->hash[j];
+            i = j;
+        }
     }
+    s->hash[i] = AIRCRAFT_NONE;
 }
 //
-// Remove stale DF's from the interactive mode linked list
+//=========================================================================
+//
+// Add a slab to the store's pool, growing the live list and the hash to match
 //
-void interactiveRemoveStaleDF( Modes *modes, time_t now) {
-    struct stDF *pDF  = NULL;
-    struct stDF *prev = NULL;
+static int aircraftStoreGrow(struct aircraftStore *s) {
+    unsigned int capacity = (s->pool.slabCount + 1) * POOL_SLAB;
+    unsigned int hashSize = 1;
+    int         *live, *hash;
+    int          j;
 
-    pDF  = modes->pDF;
-    while(pDF) {
-        if ((now - pDF->seen) > modes->interactive_delete_ttl) {
-            if (modes->pDF == pDF) {
-                modes->pDF = NULL;
-            } else {
-                prev->pNext = NULL;
-            }
+    while (hashSize < 2 * capacity) {hashSize <<= 1;}
 
-            // All DF's in the list from here onwards will be time
-            // expired, so delete them all
-            while (pDF) {
-                prev = pDF; pDF = pDF->pNext;
-                free(prev);
-            }
+    live = (int *) realloc(s->live, capacity * sizeof(*live));
+    if (live) {s->live = live;}
+    hash = (hashSize != s->hashMask + 1) ? (int *) malloc(hashSize * sizeof(*hash)) : s->hash;
 
-        } else {
-            prev = pDF; pDF = pDF->pNext;
+    s->pool.slabSize = sizeof(struct aircraftChunk) + POOL_SLAB * s->displaySize;
+
+    if (!live || !hash || !poolGrow(&s->pool)) {
+        if (hash != s->hash) {free(hash);}
+        return 0;
+    }
+
+    if (hash != s->hash) {
+        free(s->hash);
+        s->hash     = hash;
+        s->hashMask = hashSize - 1;
+        for (j = 0; j < (int) hashSize; j++) {hash[j] = AIRCRAFT_NONE;}
+        for (j = 0; j < (int) s->pool.live; j++) {aircraftHashInsert(s, s->live[j]);}
+    }
+    return 1;
+}
+//
+//=========================================================================
+//
+// Return the handle of a zeroed record for addr, or AIRCRAFT_NONE if the
+// store can't grow
+//
+static int aircraftStoreAlloc(struct aircraftStore *s, uint32_t addr) {
+    struct aircraft *a;
+    int              handle;
+
+    if (!s->pool.free && !aircraftStoreGrow(s)) {
+        return AIRCRAFT_NONE;
+    }
+
+    handle = poolAlloc(&s->pool);
+    a      = aircraftHot(s, handle);
+
+    memset(a, 0, sizeof(*a));
+    memset(aircraftCold(s, handle), 0, sizeof(struct aircraftCold));
+    a->addr   = addr;
+    a->handle = handle;
+    a->link   = s->pool.live - 1;
+
+    s->live[a->link] = handle;
+    aircraftHashInsert(s, handle);
+    return handle;
+}
+
+static void aircraftStoreFree(struct aircraftStore *s, int handle) {
+    struct aircraft *a    = aircraftHot(s, handle);
+    int              last = s->live[s->pool.live - 1];
+
+    aircraftHashRemove(s, handle);
+
+    // Move the last live aircraft into our place in the live list
+    s->live[a->link]           = last;
+    aircraftHot(s, last)->link = a->link;
+
+    poolFree(&s->pool, handle);
+}
+//
+//=========================================================================
+//
+// Add a DF to the log. Any number of threads may log at once: each one claims
+// its own slot by bumping dfHead, clears the slot's sequence number while it
+// writes, then publishes the new sequence number so readers can tell a whole
+// record from a half written or recycled one. The oldest entry in the ring
+// is simply overwritten.
+//
+// Each aircraft's chain (prevSeq and lastDF) assumes a single producer per
+// aircraft, which holds as messages are only ever decoded on one thread:
+// two threads logging for the same aircraft at once could both chain onto
+// the same lastDF and one entry would drop out of the chain. lastDF itself
+// is published atomically so interactiveFindDF() can run on another thread.
+//
+void interactiveCreateDF(Modes *modes, struct aircraft *a, struct modesMessage *mm) {
+    struct aircraftCold *c   = aircraftCold(&modes->aircraftStore, a->handle);
+    uint64_t             n   = __atomic_fetch_add(&modes->dfHead, 1, __ATOMIC_RELAXED);
+    struct stDF         *pDF = &modes->dfRing[n & (MODES_DF_RING_SIZE - 1)];
+
+    __atomic_store_n(&pDF->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    pDF->prevSeq     = __atomic_load_n(&c->lastDF, __ATOMIC_RELAXED);
+    pDF->seen        = a->seen;
+    pDF->llTimestamp = mm->timestampMsg;
+    pDF->addr        = mm->addr;
+    memcpy(pDF->msg, mm->msg, MODES_LONG_MSG_BYTES);
+
+    __atomic_store_n(&pDF->seq, n + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&c->lastDF, n + 1, __ATOMIC_RELEASE);
+}
+//
+//=========================================================================
+//
+// Copy up to max of the aircraft's logged DF's into out, newest first, and
+// return how many were copied. Each aircraft's DF's are chained through
+// prevSeq, so this only touches its own entries. The walk stops at the first
+// entry that has since been overwritten, as everything older is gone too.
+//
+int interactiveFindDF(Modes *modes, int handle, struct stDF *out, int max) {
+    uint64_t seq = __atomic_load_n(&aircraftCold(&modes->aircraftStore, handle)->lastDF, __ATOMIC_ACQUIRE);
+    uint64_t head;
+    int      n = 0;
+
+    if (!modes->dfRing) {return (0);}
+
+    head = __atomic_load_n(&modes->dfHead, __ATOMIC_ACQUIRE);
+    while ((seq) && (n < max) && ((head - seq) < MODES_DF_RING_SIZE)) {
+        struct stDF *pDF = &modes->dfRing[(seq - 1) & (MODES_DF_RING_SIZE - 1)];
+
+        if (__atomic_load_n(&pDF->seq, __ATOMIC_ACQUIRE) != seq) {break;}
+        memcpy(&out[n], pDF, sizeof(*pDF));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&pDF->seq, __ATOMIC_RELAXED) != seq) {break;}
+
+        seq = out[n++].prevSeq;
+    }
+    return (n);
+}
+//
+//===================== Mode A/C correlation indexes =======================
+//
+// Mode S aircraft are kept in two secondary indexes so that a Mode A/C reply
+// only has to look at the aircraft that could match it: one bucket per
+// squawk, and one per 100 ft Mode C altitude band.
+//
+static int modeAIndexKey(int modeA) {
+    // Squawks are four octal digits stored as 0xABCD, so pack them to 12 bits
+    return ((modeA & 0x7000) >> 3) | ((modeA & 0x0700) >> 2)
+         | ((modeA & 0x0070) >> 1) |  (modeA & 0x0007);
+}
+
+//
+// The links are handles, so unlinking needs the key the aircraft was linked
+// under: always unlink before changing a->modeA or a->modeC.
+//
+static void interactiveUnlinkModeA(Modes *modes, struct aircraft *a) {
+    struct aircraftStore *s = &modes->aircraftStore;
+
+    if (!(a->flags & AIRCRAFT_IN_MODEA)) {return;}
+
+    if (a->modeAPrev != AIRCRAFT_NONE) {
+        aircraftHot(s, a->modeAPrev)->modeANext = a->modeANext;
+    } else {
+        modes->modeAIndex[modeAIndexKey(a->modeA)] = a->modeANext;
+    }
+    if (a->modeANext != AIRCRAFT_NONE) {
+        aircraftHot(s, a->modeANext)->modeAPrev = a->modeAPrev;
+    }
+    a->flags &= ~AIRCRAFT_IN_MODEA;
+}
+
+static void interactiveUnlinkModeC(Modes *modes, struct aircraft *a) {
+    struct aircraftStore *s = &modes->aircraftStore;
+
+    if (!(a->flags & AIRCRAFT_IN_MODEC)) {return;}
+
+    if (a->modeCPrev != AIRCRAFT_NONE) {
+        aircraftHot(s, a->modeCPrev)->modeCNext = a->modeCNext;
+    } else {
+        modes->modeCIndex[a->modeC - MODEAC_MODEC_MIN] = a->modeCNext;
+    }
+    if (a->modeCNext != AIRCRAFT_NONE) {
+        aircraftHot(s, a->modeCNext)->modeCPrev = a->modeCPrev;
+    }
+    a->flags &= ~AIRCRAFT_IN_MODEC;
+}
+
+static void interactiveLinkModeA(Modes *modes, struct aircraft *a) {
+    int *head = &modes->modeAIndex[modeAIndexKey(a->modeA)];
+
+    if ((a->modeANext = *head) != AIRCRAFT_NONE) {
+        aircraftHot(&modes->aircraftStore, *head)->modeAPrev = a->handle;
+    }
+    a->modeAPrev = AIRCRAFT_NONE;
+    *head        = a->handle;
+    a->flags    |= AIRCRAFT_IN_MODEA;
+}
+
+static void interactiveLinkModeC(Modes *modes, struct aircraft *a) {
+    int *head;
+
+    if ((a->modeC < MODEAC_MODEC_MIN) || (a->modeC > MODEAC_MODEC_MAX)) {
+        return;
+    }
+    head = &modes->modeCIndex[a->modeC - MODEAC_MODEC_MIN];
+    if ((a->modeCNext = *head) != AIRCRAFT_NONE) {
+        aircraftHot(&modes->aircraftStore, *head)->modeCPrev = a->handle;
+    }
+    a->modeCPrev = AIRCRAFT_NONE;
+    *head        = a->handle;
+    a->flags    |= AIRCRAFT_IN_MODEC;
+}
+//
+//=========================================================================
+//
+// Try to match Mode A/C record a with the known Mode S aircraft, by squawk
+// and by altitude (allowing +/- 100 ft).
+//
+static void interactiveUpdateAircraftModeA(Modes *modes, struct aircraft *a) {
+    struct aircraftStore *s = &modes->aircraftStore;
+    struct aircraft      *b;
+    int                   h, band;
+
+    // If both (a) and (b) have valid squawks, check for Mode-A == Mode-S Squawk matches
+    if (a->bFlags & MODES_ACFLAGS_SQUAWK_VALID) {
+        for (h = modes->modeAIndex[modeAIndexKey(a->modeA)]; h != AIRCRAFT_NONE; h = b->modeANext) {
+            b = aircraftHot(s, h);
+            b->modeAcount   = a->messages;
+            b->modeACflags |= MODEAC_MSG_MODEA_HIT;
+            a->modeACflags |= MODEAC_MSG_MODEA_HIT;
+            if ( (b->modeAcount > 0) &&
+               ( (b->modeCcount > 1)
+              || (a->modeACflags & MODEAC_MSG_MODEA_ONLY)) ) // Allow Mode-A only matches if this Mode-A is invalid Mode-C
+                {a->modeACflags |= MODEAC_MSG_MODES_HIT;}    // flag this ModeA/C probably belongs to a known Mode S
+        }
+    }
+
+    // If both (a) and (b) have valid altitudes, check for Mode-C == Mode-S Altitude matches
+    if (a->bFlags & MODES_ACFLAGS_ALTITUDE_VALID) {
+        for (band = a->modeC - 1; band <= a->modeC + 1; band++) {
+            if ((band < MODEAC_MODEC_MIN) || (band > MODEAC_MODEC_MAX)) {continue;}
+
+            for (h = modes->modeCIndex[band - MODEAC_MODEC_MIN]; h != AIRCRAFT_NONE; h = b->modeCNext) {
+                b = aircraftHot(s, h);
+                b->modeCcount   = a->messages;
+                b->modeACflags |= MODEAC_MSG_MODEC_HIT;
+                a->modeACflags |= MODEAC_MSG_MODEC_HIT;
+                if ( (b->modeAcount > 0) &&
+                     (b->modeCcount > 1) )
+                    {a->modeACflags |= (MODEAC_MSG_MODES_HIT | MODEAC_MSG_MODEC_OLD);} // flag this ModeA/C probably belongs to a known Mode S
+            }
+        }
+    }
+}
+//
+//=========================================================================
+//
+// Re-run the Mode A/C correlation for every Mode A/C record, as the Mode S
+// aircraft they matched may have changed squawk, altitude or gone away.
+//
+void interactiveUpdateAircraftModeS(Modes *modes) {
+    struct aircraftStore *s = &modes->aircraftStore;
+    int                   j;
+
+    for (j = 0; j < (int) s->pool.live; j++) {
+        struct aircraft *a     = aircraftHot(s, s->live[j]);
+        int              flags = a->modeACflags;
+        if (flags & MODEAC_MSG_FLAG) { // find any fudged ICAO records
+            // clear the current A,C and S hit bits ready for this attempt
+            a->modeACflags = flags & ~(MODEAC_MSG_MODEA_HIT | MODEAC_MSG_MODEC_HIT | MODEAC_MSG_MODES_HIT);
+            interactiveUpdateAircraftModeA(modes, a);  // and attempt to match them with Mode-S
         }
     }
 }
+//
+//========================= Aircraft expiry ================================
+//
+// One timer per aircraft does both jobs: it first fires when the aircraft is
+// due to fade, then when it is due to be deleted. Either way it checks
+// a->seen first and re-arms itself if the aircraft was heard from since.
+//
+#define aircraftFromTimer(n) \
+    ((struct aircraft *) ((char *) (n) - offsetof(struct aircraft, expiry)))
+
+static time_t interactiveExpiryDue(Modes *modes, struct aircraft *a) {
+    time_t fadeAt   = a->seen + modes->interactive_fade_ttl;
+    time_t deleteAt = a->seen + modes->interactive_delete_ttl + 1;
 
-// struct stDF *interactiveFindDF(Modes *modes, uint32_t addr) {
-//     struct stDF *pDF = NULL;
+    return ((a->flags & AIRCRAFT_FADED) || (deleteAt < fadeAt)) ? deleteAt : fadeAt;
+}
 
-//     pDF = modes->pDF;
-//     while(pDF) {
-//         if (pDF->addr == addr) {
-//             return (pDF);
-//         }
-//         pDF = pDF->pNext;
-//     }
+static void interactiveExpireAircraft(void *ctx, struct timerNode *n) {
+    Modes           *modes = (Modes *) ctx;
+    struct aircraft *a     = aircraftFromTimer(n);
 
+    if ((modes->clock_now - a->seen) >= modes->interactive_fade_ttl) {
+        a->flags |= AIRCRAFT_FADED;
+    }
+    if ((modes->clock_now - a->seen) <= modes->interactive_delete_ttl) {
+        timerAdd(&modes->expiry, n, interactiveExpiryDue(modes, a));
+        return;
+    }
 
-//     return (NULL);
-// }
+    interactiveUnlinkModeA(modes, a);
+    interactiveUnlinkModeC(modes, a);
+    if (modes->aircraftRemoved) {
+        modes->aircraftRemoved(modes->aircraftHookCtx, a->handle);
+    }
+    aircraftStoreFree(&modes->aircraftStore, a->handle);
+}
 //
 //========================= Interactive mode ===============================
 //
-// Return a new aircraft structure for the interactive mode linked list
-// of aircraft
+// Return a new aircraft structure for the interactive mode aircraft store
 //
-struct aircraft *interactiveCreateAircraft(struct modesMessage *mm) {
-    struct aircraft *a = (struct aircraft *) malloc(sizeof(*a));
+struct aircraft *interactiveCreateAircraft(Modes *modes, struct modesMessage *mm) {
+    int              handle = aircraftStoreAlloc(&modes->aircraftStore, mm->addr);
+    struct aircraft *a;
 
-    // Default everything to zero/NULL
-    memset(a, 0, sizeof(*a));
+    if (handle == AIRCRAFT_NONE) {
+        return NULL;
+    }
 
-    // Now initialise things that should not be 0/NULL to their defaults
-    a->addr = mm->addr;
-    a->lat  = a->lon = 0.0;
+    // The store hands records out zeroed, now initialise things that should
+    // not be 0/NULL to their defaults
+    a = aircraftHot(&modes->aircraftStore, handle);
+    timerInit(&a->expiry, interactiveExpireAircraft);
+    a->modeANext = a->modeAPrev = AIRCRAFT_NONE;
+    a->modeCNext = a->modeCPrev = AIRCRAFT_NONE;
     memset(a->signalLevel, mm->signalLevel, 8); // First time, initialise everything
                                                 // to the first signal strength
 
@@ -155,17 +460,19 @@ struct aircraft *interactiveCreateAircraft(struct modesMessage *mm) {
 //
 //=========================================================================
 //
-// Return the aircraft with the specified address, or NULL if no aircraft
-// exists with this address.
+// Return the handle of the aircraft with the specified address, or
+// AIRCRAFT_NONE if no aircraft exists with this address.
 //
-struct aircraft *interactiveFindAircraft(Modes *modes, uint32_t addr) {
-    struct aircraft *a = modes->aircrafts;
+int interactiveFindAircraft(Modes *modes, uint32_t addr) {
+    struct aircraftStore *s = &modes->aircraftStore;
+    unsigned int          i;
 
-    while(a) {
-        if (a->addr == addr) return (a);
-        a = a->next;
+    if (!s->hash) {return (AIRCRAFT_NONE);}
+
+    for (i = aircraftHashSlot(s, addr); s->hash[i] != AIRCRAFT_NONE; i = (i + 1) & s->hashMask) {
+        if (aircraftHot(s, s->hash[i])->addr == addr) {return (s->hash[i]);}
     }
-    return (NULL);
+    return (AIRCRAFT_NONE);
 }
 
 //
@@ -174,45 +481,52 @@ struct aircraft *interactiveFindAircraft(Modes *modes, uint32_t addr) {
 // Receive new messages and populate the interactive mode with more info
 //
 struct aircraft *interactiveReceiveData(Modes *modes, struct modesMessage *mm) {
-    struct aircraft *a, *aux;
+    struct aircraft     *a;
+    struct aircraftCold *c;
+    int                  handle;
 
     // Return if (checking crc) AND (not crcok) AND (not fixed)
     if (modes->check_crc && (mm->crcok == 0) && (mm->correctedbits == 0))
         return NULL;
 
     // Lookup our aircraft or create a new one
-    a = interactiveFindAircraft(modes, mm->addr);
-    if (!a) {                              // If it's a currently unknown aircraft....
-        a = interactiveCreateAircraft(mm); // ., create a new record for it,
-        a->next = modes->aircrafts;         // .. and put it at the head of the list
-        modes->aircrafts = a;
-    } else {
-        /* If it is an already known aircraft, move it on head
-         * so we keep aircrafts ordered by received message time.
-         *
-         * However move it on head only if at least one second elapsed
-         * since the aircraft that is currently on head sent a message,
-         * othewise with multiple aircrafts at the same time we have an
-         * useless shuffle of positions on the screen. */
-        if (0 && modes->aircrafts != a && (time(NULL) - a->seen) >= 1) {
-            aux = modes->aircrafts;
-            while(aux->next != a) aux = aux->next;
-            /* Now we are a node before the aircraft to remove. */
-            aux->next = aux->next->next; /* removed. */
-            /* Add on head */
-            a->next = modes->aircrafts;
-            modes->aircrafts = a;
+    handle = interactiveFindAircraft(modes, mm->addr);
+    if (handle != AIRCRAFT_NONE) {
+        a = aircraftHot(&modes->aircraftStore, handle);
+    } else {                               // If it's a currently unknown aircraft....
+        a = interactiveCreateAircraft(modes, mm); // ., create a new record for it,
+        if (!a) {
+            return NULL;
+        }
+        if (modes->aircraftCreated) {       // ... and let the display know about it
+            modes->aircraftCreated(modes->aircraftHookCtx, a->handle);
         }
     }
+    c = aircraftCold(&modes->aircraftStore, a->handle);
 
     a->signalLevel[a->messages & 7] = mm->signalLevel;// replace the 8th oldest signal strength
-    a->seen      = time(NULL);
-    a->timestamp = mm->timestampMsg;
+    a->seen      = modes->clock_now;
+
+    // The timer is only armed here when idle or faded; when it fires it
+    // checks a->seen and re-arms itself if the aircraft was heard from
+    // since, so a busy aircraft costs nothing per message.
+    if ((a->flags & AIRCRAFT_FADED) || !timerPending(&a->expiry)) {
+        a->flags &= ~AIRCRAFT_FADED;
+        timerAdd(&modes->expiry, &a->expiry, interactiveExpiryDue(modes, a));
+    }
     a->messages++;
 
+    // Keep the raw MB field of Comm-B replies, decodeCommB() works out what
+    // it holds if anyone asks
+    if ((mm->msgtype == 20) || (mm->msgtype == 21)) {
+        unsigned int slot = c->commBCount++ % MODES_COMMB_RING;
+        memcpy(c->commB[slot], &mm->msg[4], MODES_COMMB_MB_BYTES);
+        c->commBSeen[slot] = modes->clock_now;
+    }
+
     // If a (new) CALLSIGN has been received, copy it to the aircraft structure
     if (mm->bFlags & MODES_ACFLAGS_CALLSIGN_VALID) {
-        memcpy(a->flight, mm->flight, sizeof(a->flight));
+        memcpy(c->flight, mm->flight, sizeof(c->flight));
     }
 
     // If a (new) ALTITUDE has been received, copy it to the aircraft structure
@@ -226,7 +540,13 @@ struct aircraft *interactiveReceiveData(Modes *modes, struct modesMessage *mm) {
             a->modeACflags &= ~MODEAC_MSG_MODEC_HIT;
             }
         a->altitude = mm->altitude;
-        a->modeC    = (mm->altitude + 49) / 100;
+        if ((a->modeC != (mm->altitude + 49) / 100) || !(a->flags & AIRCRAFT_IN_MODEC)) {
+            interactiveUnlinkModeC(modes, a);
+            a->modeC = (mm->altitude + 49) / 100;
+            if (!(a->modeACflags & MODEAC_MSG_FLAG)) {
+                interactiveLinkModeC(modes, a);
+            }
+        }
     }
 
     // If a (new) SQUAWK has been received, copy it to the aircraft structure
@@ -235,7 +555,13 @@ struct aircraft *interactiveReceiveData(Modes *modes, struct modesMessage *mm) {
             a->modeAcount   = 0; // Squawk has changed, so zero the hit count
             a->modeACflags &= ~MODEAC_MSG_MODEA_HIT;
         }
-        a->modeA = mm->modeA;
+        if ((a->modeA != mm->modeA) || !(a->flags & AIRCRAFT_IN_MODEA)) {
+            interactiveUnlinkModeA(modes, a);
+            a->modeA = mm->modeA;
+            if (!(a->modeACflags & MODEAC_MSG_FLAG)) {
+                interactiveLinkModeA(modes, a);
+            }
+        }
     }
 
     // If a (new) HEADING has been received, copy it to the aircraft structure
@@ -265,11 +591,11 @@ struct aircraft *interactiveReceiveData(Modes *modes, struct modesMessage *mm) {
         if (mm->bFlags & MODES_ACFLAGS_LLODD_VALID) {
             a->odd_cprlat  = mm->raw_latitude;
             a->odd_cprlon  = mm->raw_longitude;
-            a->odd_cprtime = mstime();
+            a->odd_cprtime = modes->clock_mono_ms;
         } else {
             a->even_cprlat  = mm->raw_latitude;
             a->even_cprlon  = mm->raw_longitude;
-            a->even_cprtime = mstime();
+            a->even_cprtime = modes->clock_mono_ms;
         }
 
         // If we have enough recent data, try global CPR
@@ -311,6 +637,7 @@ struct aircraft *interactiveReceiveData(Modes *modes, struct modesMessage *mm) {
             a->modeACflags = flags & ~MODEAC_MSG_MODEC_OLD;
             a->messages    = 1;
         }
+        interactiveUpdateAircraftModeA(modes, a);
     }
 
     // If we are Logging DF's, and it's not a Mode A/C
@@ -326,30 +653,21 @@ struct aircraft *interactiveReceiveData(Modes *modes, struct modesMessage *mm) {
 //
 // When in interactive mode If we don't receive new nessages within
 // MODES_INTERACTIVE_DELETE_TTL seconds we remove the aircraft from the list.
+// The expiry timer wheel does the work, so this only costs anything for the
+// aircraft that are actually due.
 //
 void interactiveRemoveStaleAircrafts(Modes *modes) {
-    struct aircraft *a = modes->aircrafts;
-    struct aircraft *prev = NULL;
-    time_t now = time(NULL);
+    time_t now = modes->clock_now;
 
     // Only do cleanup once per second
     if (modes->last_cleanup_time != now) {
         modes->last_cleanup_time = now;
 
-        interactiveRemoveStaleDF(modes,now);
-
-        while(a) {
-            if ((now - a->seen) > modes->interactive_delete_ttl) {
-                // Remove the element from the linked list, with care
-                // if we are removing the first element
-                if (!prev) {
-                    modes->aircrafts = a->next; free(a); a = modes->aircrafts;
-                } else {
-                    prev->next = a->next; free(a); a = prev->next;
-                }
-            } else {
-                prev = a; a = a->next;
-            }
+        // Fires the fade and delete timers of the aircraft that are due
+        timerWheelAdvance(&modes->expiry, now, modes);
+
+        if (modes->mode_ac) {
+            interactiveUpdateAircraftModeS(modes);
         }
     }
 }
@@ -46,11 +46,15 @@ def extractLines(shapefile, tolerance):
 
 parser = argparse.ArgumentParser(description='viz1090 Natural Earth Data Map Converter')
 parser.add_argument("--tolerance", default=0.001, type=float, help="map simplification tolerance")
+parser.add_argument("--levels", default=4, type=int, help="coarser levels of detail for mapdata-lod.bin, each 4x the tolerance of the last")
 parser.add_argument("--scale", default="10m", choices=["10m","50m","110m"], type=str, help="map file scale")
 parser.add_argument("mapfile", type=str, help="shapefile to load (e.g., from https://www.naturalearthdata.com/downloads/")	
 
 args = parser.parse_args()
 
+if args.levels < 0 or args.levels > 16:
+	parser.error("--levels must be between 0 and 16")
+
 shapefile = geopandas.read_file(args.mapfile)
 
 outlist = extractLines(shapefile, args.tolerance)
@@ -59,4 +63,23 @@ bin_file = open("mapdata.bin", "wb")
 np.asarray(outlist).astype(np.single).tofile(bin_file)
 bin_file.close()
 
-print("Wrote %d points" % (len(outlist) / 2))
\ No newline at end of file
+print("Wrote %d points" % (len(outlist) / 2))
+
+# "VLOD", base tolerance, mapdata.bin point count, level count, then per level its tolerance, point count and points.
+# viz1090 ignores the file if the point count doesn't match mapdata.bin
+lod_file = open("mapdata-lod.bin", "wb")
+lod_file.write(b"VLOD")
+np.asarray([args.tolerance]).astype(np.single).tofile(lod_file)
+np.asarray([len(outlist) // 2, args.levels]).astype(np.int32).tofile(lod_file)
+
+for level in range(1, args.levels + 1):
+	tolerance = args.tolerance * 4 ** level
+	levellist = extractLines(shapefile, tolerance)
+
+	np.asarray([tolerance]).astype(np.single).tofile(lod_file)
+	np.asarray([len(levellist) // 2]).astype(np.int32).tofile(lod_file)
+	np.asarray(levellist).astype(np.single).tofile(lod_file)
+
+	print("Level %d: tolerance %g, %d points" % (level, tolerance, len(levellist) / 2))
+
+lod_file.close()
\ No newline at end of file
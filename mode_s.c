@@ -266,7 +266,7 @@ uint32_t ICAOCacheHashAddress(uint32_t a) {
 void addRecentlySeenICAOAddr(Modes *modes, uint32_t addr) {
     uint32_t h = ICAOCacheHashAddress(addr);
     modes->icao_cache[h*2] = addr;
-    modes->icao_cache[h*2+1] = (uint32_t) time(NULL);
+    modes->icao_cache[h*2+1] = (uint32_t) modes->clock_now;
 }
 //
 //=========================================================================
@@ -279,7 +279,7 @@ int ICAOAddressWasRecentlySeen(Modes *modes, uint32_t addr) {
     uint32_t h = ICAOCacheHashAddress(addr);
     uint32_t a = modes->icao_cache[h*2];
     uint32_t t = modes->icao_cache[h*2+1];
-    uint64_t tn = time(NULL);
+    uint64_t tn = modes->clock_now;
 
     return ( (a) && (a == addr) && ( (tn - t) <= MODES_ICAO_CACHE_TTL) );
 }
@@ -791,6 +791,217 @@ void decodeModesMessage(Modes *modes, struct modesMessage *mm, unsigned char *ms
     }
 }
 
+//
+//=========================================================================
+//
+// ========================== Comm-B BDS inference =========================
+//
+// DF20/21 replies carry a 56 bit MB field with the contents of whichever
+// BDS register the interrogator asked for, but the reply doesn't say which
+// one. Apart from BDS 2,0, which starts with its own number, the register
+// has to be guessed from the status bits and the plausibility of the
+// values, so this is only done on demand for one aircraft at a time.
+//
+// Return bits first..last (numbered from 1, as in the ICAO documents) of an
+// MB field.
+//
+static uint32_t commBBits(const unsigned char *mb, int first, int last) {
+    uint32_t v = 0;
+    int      b;
+
+    for (b = first; b <= last; b++) {
+        v = (v << 1) | ((mb[(b-1) >> 3] >> (7 - ((b-1) & 7))) & 1);
+    }
+    return v;
+}
+//
+// A field whose status bit is clear must be all zeros
+//
+static int commBStatusOk(const unsigned char *mb, int status, int last) {
+    return commBBits(mb, status, status) || (commBBits(mb, status + 1, last) == 0);
+}
+//
+// Sign bit at 'sign', two's complement magnitude in sign+1..last
+//
+static int commBSigned(const unsigned char *mb, int sign, int last) {
+    int value = (int) commBBits(mb, sign + 1, last);
+    if (commBBits(mb, sign, sign)) {value -= (1 << (last - sign));}
+    return value;
+}
+
+static int commBIsBDS20(const unsigned char *mb, struct commB *cb) {
+    char *ais_charset = "?ABCDEFGHIJKLMNOPQRSTUVWXYZ????? ???????????????0123456789??????";
+    int   j;
+
+    if (mb[0] != 0x20) {return 0;}
+
+    for (j = 0; j < 8; j++) {
+        char c = ais_charset[commBBits(mb, 9 + j*6, 14 + j*6)];
+        if (c == '?') {return 0;}
+        cb->flight[j] = c;
+    }
+    cb->flight[8] = '\0';
+    return 1;
+}
+
+static int commBIsBDS40(const unsigned char *mb, struct commB *cb) {
+    if ( (commBBits(mb, 40, 47)) || (commBBits(mb, 52, 53))
+      || (!commBStatusOk(mb,  1, 13)) || (!commBStatusOk(mb, 14, 26))
+      || (!commBStatusOk(mb, 27, 39)) || (!commBStatusOk(mb, 48, 51))
+      || (!commBStatusOk(mb, 54, 56)) ) {
+        return 0;
+    }
+    if (!(commBBits(mb, 1, 1) | commBBits(mb, 14, 14) | commBBits(mb, 27, 27))) {
+        return 0;
+    }
+
+    cb->selAltMCP = commBBits(mb,  2, 13) * 16;
+    cb->selAltFMS = commBBits(mb, 15, 26) * 16;
+    cb->baro      = commBBits(mb, 28, 39) * 0.1f + 800.0f;
+
+    if ( (commBBits(mb,  1,  1) && (cb->selAltMCP > 50000))
+      || (commBBits(mb, 14, 14) && (cb->selAltFMS > 50000))
+      || (commBBits(mb, 27, 27) && ((cb->baro < 900.0f) || (cb->baro > 1100.0f))) ) {
+        return 0;
+    }
+    return 1;
+}
+
+static int commBIsBDS50(const unsigned char *mb, struct commB *cb) {
+    if ( (!commBStatusOk(mb,  1, 11)) || (!commBStatusOk(mb, 12, 23))
+      || (!commBStatusOk(mb, 24, 34)) || (!commBStatusOk(mb, 35, 45))
+      || (!commBStatusOk(mb, 46, 56)) ) {
+        return 0;
+    }
+    if (!(commBBits(mb, 1, 1) | commBBits(mb, 12, 12) | commBBits(mb, 24, 24) | commBBits(mb, 46, 46))) {
+        return 0;
+    }
+
+    cb->roll  = commBSigned(mb,  2, 11) * 45.0f / 256.0f;
+    cb->track = commBSigned(mb, 13, 23) * 90.0f / 512.0f;
+    if (cb->track < 0) {cb->track += 360.0f;}
+    cb->gs    = commBBits(mb, 25, 34) * 2;
+    cb->tas   = commBBits(mb, 47, 56) * 2;
+
+    if ( (commBBits(mb,  1,  1) && (fabs(cb->roll) > 50.0))
+      || (commBBits(mb, 24, 24) && (cb->gs  > 600))
+      || (commBBits(mb, 46, 46) && (cb->tas > 600))
+      || (commBBits(mb, 24, 24) && commBBits(mb, 46, 46) && (abs(cb->gs - cb->tas) > 200)) ) {
+        return 0;
+    }
+    return 1;
+}
+
+static int commBIsBDS60(const unsigned char *mb, struct commB *cb) {
+    if ( (!commBStatusOk(mb,  1, 12)) || (!commBStatusOk(mb, 13, 23))
+      || (!commBStatusOk(mb, 24, 34)) || (!commBStatusOk(mb, 35, 45))
+      || (!commBStatusOk(mb, 46, 56)) ) {
+        return 0;
+    }
+    if (!(commBBits(mb, 1, 1) | commBBits(mb, 13, 13) | commBBits(mb, 24, 24) | commBBits(mb, 35, 35))) {
+        return 0;
+    }
+
+    cb->heading  = commBSigned(mb,  2, 12) * 90.0f / 512.0f;
+    if (cb->heading < 0) {cb->heading += 360.0f;}
+    cb->ias      = commBBits(mb, 14, 23);
+    cb->mach     = commBBits(mb, 25, 34) * 2.048f / 512.0f;
+    cb->vertRate = commBSigned(mb, 36, 45) * 32;
+
+    if ( (commBBits(mb, 13, 13) && ((cb->ias == 0) || (cb->ias > 500)))
+      || (commBBits(mb, 24, 24) && (cb->mach > 1.0f))
+      || (commBBits(mb, 35, 35) && (abs(cb->vertRate) > 6000)) ) {
+        return 0;
+    }
+    return 1;
+}
+//
+// Smallest difference between two angles in degrees
+//
+static float commBAngleDiff(float a, float b) {
+    float d = (float) fabs(fmod(a - b, 360.0));
+    return (d > 180.0f) ? 360.0f - d : d;
+}
+//
+//=========================================================================
+//
+// Work out which BDS registers the stored MB fields of aircraft a (kept in
+// its cold record c) hold and decode them into cb, newest first. Returns the
+// number of MB fields that could be identified.
+//
+// BDS 5,0 and 6,0 often both look plausible. When that happens the ADS-B
+// speed and track break the tie: 5,0 ground speed and true track should be
+// close to them, 6,0 magnetic heading only roughly so.
+//
+int decodeCommB(struct aircraft *a, struct aircraftCold *c, struct commB *cb) {
+    unsigned int n = (c->commBCount < MODES_COMMB_RING) ? c->commBCount : MODES_COMMB_RING;
+    unsigned int k;
+    int          found = 0;
+
+    memset(cb, 0, sizeof(*cb));
+
+    for (k = 0; k < n; k++) {
+        unsigned int   slot = (c->commBCount - 1 - k) % MODES_COMMB_RING;
+        unsigned char *mb   = c->commB[slot];
+        struct commB   b40, b50, b60;
+        int            is40, is50, is60;
+
+        if ((a->seen - c->commBSeen[slot]) > 60) {continue;} // Too old to be worth showing
+
+        // Only read back when the matching commBIsBDS* accepted the field,
+        // but gcc can't follow that through the tie break below
+        memset(&b40, 0, sizeof(b40));
+        memset(&b50, 0, sizeof(b50));
+        memset(&b60, 0, sizeof(b60));
+
+        if (commBIsBDS20(mb, &b40)) {
+            if (!(cb->valid & COMMB_BDS20_VALID)) {
+                memcpy(cb->flight, b40.flight, sizeof(cb->flight));
+                cb->valid |= COMMB_BDS20_VALID;
+            }
+            found++;
+            continue;
+        }
+
+        is40 = commBIsBDS40(mb, &b40);
+        is50 = commBIsBDS50(mb, &b50);
+        is60 = commBIsBDS60(mb, &b60);
+
+        if (is50 && is60) {
+            if ((a->bFlags & (MODES_ACFLAGS_SPEED_VALID | MODES_ACFLAGS_HEADING_VALID))
+                          != (MODES_ACFLAGS_SPEED_VALID | MODES_ACFLAGS_HEADING_VALID)) {
+                is50 = is60 = 0;
+            } else if ( commBBits(mb, 24, 24) && (abs(b50.gs - a->speed) <= 30)
+                     && commBBits(mb, 12, 12) && (commBAngleDiff(b50.track, (float) a->track) <= 10.0f) ) {
+                is60 = 0;
+            } else if ( commBBits(mb, 1, 1) && (commBAngleDiff(b60.heading, (float) a->track) <= 45.0f) ) {
+                is50 = 0;
+            } else {
+                is50 = is60 = 0;
+            }
+        }
+        if (is40 + is50 + is60 != 1) {continue;} // Nothing, or still ambiguous
+        found++;
+
+        if (is40) {
+            if (commBBits(mb,  1,  1) && !(cb->valid & COMMB_BDS40_MCP_VALID))  {cb->selAltMCP = b40.selAltMCP; cb->valid |= COMMB_BDS40_MCP_VALID;}
+            if (commBBits(mb, 14, 14) && !(cb->valid & COMMB_BDS40_FMS_VALID))  {cb->selAltFMS = b40.selAltFMS; cb->valid |= COMMB_BDS40_FMS_VALID;}
+            if (commBBits(mb, 27, 27) && !(cb->valid & COMMB_BDS40_BARO_VALID)) {cb->baro      = b40.baro;      cb->valid |= COMMB_BDS40_BARO_VALID;}
+        } else if (is50) {
+            if (commBBits(mb,  1,  1) && !(cb->valid & COMMB_BDS50_ROLL_VALID))  {cb->roll  = b50.roll;  cb->valid |= COMMB_BDS50_ROLL_VALID;}
+            if (commBBits(mb, 12, 12) && !(cb->valid & COMMB_BDS50_TRACK_VALID)) {cb->track = b50.track; cb->valid |= COMMB_BDS50_TRACK_VALID;}
+            if (commBBits(mb, 24, 24) && !(cb->valid & COMMB_BDS50_GS_VALID))    {cb->gs    = b50.gs;    cb->valid |= COMMB_BDS50_GS_VALID;}
+            if (commBBits(mb, 46, 46) && !(cb->valid & COMMB_BDS50_TAS_VALID))   {cb->tas   = b50.tas;   cb->valid |= COMMB_BDS50_TAS_VALID;}
+        } else {
+            if (commBBits(mb,  1,  1) && !(cb->valid & COMMB_BDS60_HDG_VALID))  {cb->heading  = b60.heading;  cb->valid |= COMMB_BDS60_HDG_VALID;}
+            if (commBBits(mb, 13, 13) && !(cb->valid & COMMB_BDS60_IAS_VALID))  {cb->ias      = b60.ias;      cb->valid |= COMMB_BDS60_IAS_VALID;}
+            if (commBBits(mb, 24, 24) && !(cb->valid & COMMB_BDS60_MACH_VALID)) {cb->mach     = b60.mach;     cb->valid |= COMMB_BDS60_MACH_VALID;}
+            if (commBBits(mb, 35, 35) && !(cb->valid & COMMB_BDS60_VR_VALID))   {cb->vertRate = b60.vertRate; cb->valid |= COMMB_BDS60_VR_VALID;}
+        }
+    }
+    return found;
+}
+
 //=========================================================================
 //
 // Return -1 if the message is out of fase left-side
@@ -811,8 +1022,8 @@ int detectOutOfPhase(uint16_t *pPreamble) {
 
 uint16_t clamped_scale(uint16_t v, uint16_t scale) {
     uint32_t scaled = (uint32_t)v * scale / 16384;
-    if (scaled > 65535) return 65535;
-    return (uint16_t) scaled;
+    // Saturate to 65535 without a branch
+    return (uint16_t) (scaled | -(uint32_t) (scaled > 65535));
 }
 // This function decides whether we are sampling early or late,
 // and by approximately how much, by looking at the energy in
@@ -848,15 +1059,13 @@ void applyPhaseCorrection(uint16_t *pPayload) {
         pPayload[MODES_PREAMBLE_SAMPLES + MODES_LONG_MSG_SAMPLES - 1] =
             clamped_scale(pPayload[MODES_PREAMBLE_SAMPLES + MODES_LONG_MSG_SAMPLES - 1],  scaleUp);
         for (j = MODES_PREAMBLE_SAMPLES + MODES_LONG_MSG_SAMPLES - 2; j > MODES_PREAMBLE_SAMPLES; j -= 2) {
-            if (pPayload[j] > pPayload[j+1]) {
-                // x [1 0] y
-                // x overlapped with the "1" bit and is slightly high
-                pPayload[j-1] = clamped_scale(pPayload[j-1], scaleDown);
-            } else {
-                // x [0 1] y
-                // x overlapped with the "0" bit and is slightly low
-                pPayload[j-1] = clamped_scale(pPayload[j-1], scaleUp);
-            }
+            // x [1 0] y : x overlapped with the "1" bit and is slightly high
+            // x [0 1] y : x overlapped with the "0" bit and is slightly low
+            // Each decision looks at the sample the previous step rescaled,
+            // so this can't be vectorized; select the scale without a branch
+            // instead, as the bit pattern is unpredictable.
+            uint32_t one = -(uint32_t) (pPayload[j] > pPayload[j+1]);
+            pPayload[j-1] = clamped_scale(pPayload[j-1], (uint16_t) ((scaleDown & one) | (scaleUp & ~one)));
         }
     } else {
         // Our sample period starts early and so includes some of the previous bit.
@@ -867,14 +1076,470 @@ void applyPhaseCorrection(uint16_t *pPayload) {
         // leading bits are 0; first data sample will be a bit low.
         pPayload[MODES_PREAMBLE_SAMPLES] = clamped_scale(pPayload[MODES_PREAMBLE_SAMPLES], scaleUp);
         for (j = MODES_PREAMBLE_SAMPLES; j < MODES_PREAMBLE_SAMPLES + MODES_LONG_MSG_SAMPLES - 2; j += 2) {
-            if (pPayload[j] > pPayload[j+1]) {
-                // x [1 0] y
-                // y overlapped with the "0" bit and is slightly low
-                pPayload[j+2] = clamped_scale(pPayload[j+2], scaleUp);
+            // x [1 0] y : y overlapped with the "0" bit and is slightly low
+            // x [0 1] y : y overlapped with the "1" bit and is slightly high
+            uint32_t one = -(uint32_t) (pPayload[j] > pPayload[j+1]);
+            pPayload[j+2] = clamped_scale(pPayload[j+2], (uint16_t) ((scaleUp & one) | (scaleDown & ~one)));
+        }
+    }
+}
+//
+//=========================================================================
+//
+// ===================== Mode S demodulation (--ifile) ====================
+//
+// Allocate the sample buffers and build the I/Q -> magnitude lookup table
+// used when demodulating 8 bit I/Q recordings.
+//
+static void selectMagnitudeKernel(Modes *modes);
+
+void modesInitDemod(Modes *modes) {
+    int i, q;
+
+    if ( (NULL == (modes->pFileData = (uint16_t *) malloc(MODES_ASYNC_BUF_SIZE)                                            ))
+      || (NULL == (modes->magnitude = (uint16_t *) calloc(1, MODES_ASYNC_BUF_SIZE+MODES_PREAMBLE_SIZE+MODES_LONG_MSG_SIZE)))
+      || (NULL == (modes->maglut    = (uint16_t *) malloc(sizeof(uint16_t) * 256 * 256)                                    )) ) {
+        fprintf(stderr, "Out of memory allocating demodulator buffers.\n");
+        exit(1);
+    }
+
+    // The samples are unsigned 8 bit I/Q pairs centered on 127.5. Scale the
+    // magnitude so that full scale (255*sqrt(2)) maps onto 65535, and a zero
+    // signal maps onto 0.
+    for (i = 0; i <= 255; i++) {
+        for (q = 0; q <= 255; q++) {
+            int mag, mag_i, mag_q;
+
+            mag_i = (i * 2) - 255;
+            mag_q = (q * 2) - 255;
+            mag   = (int) round((sqrt((mag_i*mag_i)+(mag_q*mag_q)) * 258.433254) - 365.4798);
+            modes->maglut[(i*256)+q] = (uint16_t) ((mag < 65535) ? mag : 65535);
+        }
+    }
+    selectMagnitudeKernel(modes);
+}
+//
+//=========================================================================
+//
+// I/Q -> magnitude kernels. Each takes n 16 bit I/Q sample pairs and writes
+// n magnitudes. magnitudeScalar() goes through the lookup table and is the
+// reference the vector versions must match bit for bit: they compute the
+// same double precision expression as the table builder and round to
+// nearest, which gives identical results for every one of the 65536 inputs
+// (modesInitDemod() checks this before using them, and tests/demod_test.c
+// checks it for every kernel the CPU can run).
+//
+
+static void magnitudeScalar(Modes *modes, const uint16_t *p, uint16_t *m, uint32_t n) {
+    uint32_t j;
+    for (j = 0; j < n; j++) {
+        m[j] = modes->maglut[p[j]];
+    }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MODES_HAVE_X86_KERNELS
+
+// 8 samples per step: widen the 16 interleaved I/Q bytes to 16 bit, map
+// them onto -255..255, and madd each pair into I*I+Q*Q.
+__attribute__((target("sse4.1")))
+static void magnitudeSSE41(Modes *modes, const uint16_t *p, uint16_t *m, uint32_t n) {
+    const __m128i k255  = _mm_set1_epi16(255);
+    const __m128d scale = _mm_set1_pd(258.433254);
+    const __m128d bias  = _mm_set1_pd(365.4798);
+    uint32_t j;
+
+    for (j = 0; j + 8 <= n; j += 8) {
+        __m128i v  = _mm_loadu_si128((const __m128i *) &p[j]);
+        __m128i lo = _mm_sub_epi16(_mm_slli_epi16(_mm_cvtepu8_epi16(v), 1), k255);
+        __m128i hi = _mm_sub_epi16(_mm_slli_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(v, 8)), 1), k255);
+        __m128i s0 = _mm_madd_epi16(lo, lo);
+        __m128i s1 = _mm_madd_epi16(hi, hi);
+        __m128i r[4];
+        int     k;
+
+        for (k = 0; k < 4; k++) {
+            __m128i s = (k < 2) ? s0 : s1;
+            __m128d d = _mm_cvtepi32_pd((k & 1) ? _mm_srli_si128(s, 8) : s);
+            d    = _mm_sub_pd(_mm_mul_pd(_mm_sqrt_pd(d), scale), bias);
+            r[k] = _mm_cvtpd_epi32(d);
+        }
+        // packus saturates to 0..65535, which is the table's clamp
+        _mm_storeu_si128((__m128i *) &m[j],
+                         _mm_packus_epi32(_mm_unpacklo_epi64(r[0], r[1]), _mm_unpacklo_epi64(r[2], r[3])));
+    }
+    magnitudeScalar(modes, &p[j], &m[j], n - j);
+}
+
+__attribute__((target("avx2")))
+static void magnitudeAVX2(Modes *modes, const uint16_t *p, uint16_t *m, uint32_t n) {
+    const __m256i k255  = _mm256_set1_epi16(255);
+    const __m256d scale = _mm256_set1_pd(258.433254);
+    const __m256d bias  = _mm256_set1_pd(365.4798);
+    uint32_t j;
+
+    for (j = 0; j + 8 <= n; j += 8) {
+        __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) &p[j]));
+        __m256i s;
+        __m256d d0, d1;
+
+        v  = _mm256_sub_epi16(_mm256_slli_epi16(v, 1), k255);
+        s  = _mm256_madd_epi16(v, v);
+        d0 = _mm256_cvtepi32_pd(_mm256_castsi256_si128(s));
+        d1 = _mm256_cvtepi32_pd(_mm256_extracti128_si256(s, 1));
+        d0 = _mm256_sub_pd(_mm256_mul_pd(_mm256_sqrt_pd(d0), scale), bias);
+        d1 = _mm256_sub_pd(_mm256_mul_pd(_mm256_sqrt_pd(d1), scale), bias);
+        _mm_storeu_si128((__m128i *) &m[j],
+                         _mm_packus_epi32(_mm256_cvtpd_epi32(d0), _mm256_cvtpd_epi32(d1)));
+    }
+    magnitudeScalar(modes, &p[j], &m[j], n - j);
+}
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MODES_HAVE_NEON_KERNELS
+
+static void magnitudeNEON(Modes *modes, const uint16_t *p, uint16_t *m, uint32_t n) {
+    const int16x8_t   k255  = vdupq_n_s16(255);
+    const float64x2_t scale = vdupq_n_f64(258.433254);
+    const float64x2_t bias  = vdupq_n_f64(365.4798);
+    uint32_t j;
+
+    for (j = 0; j + 4 <= n; j += 4) {
+        uint8x8_t  v = vld1_u8((const uint8_t *) &p[j]);
+        int16x8_t  d = vsubq_s16(vshlq_n_s16(vreinterpretq_s16_u16(vmovl_u8(v)), 1), k255);
+        int32x4_t  s = vpaddq_s32(vmull_s16(vget_low_s16(d), vget_low_s16(d)),
+                                  vmull_high_s16(d, d));
+        float64x2_t f0 = vcvtq_f64_s64(vmovl_s32(vget_low_s32(s)));
+        float64x2_t f1 = vcvtq_f64_s64(vmovl_high_s32(s));
+
+        // vrndaq rounds half away from zero, like round()
+        f0 = vrndaq_f64(vsubq_f64(vmulq_f64(vsqrtq_f64(f0), scale), bias));
+        f1 = vrndaq_f64(vsubq_f64(vmulq_f64(vsqrtq_f64(f1), scale), bias));
+        vst1_u16(&m[j], vqmovun_s32(vcombine_s32(vmovn_s64(vcvtq_s64_f64(f0)),
+                                                 vmovn_s64(vcvtq_s64_f64(f1)))));
+    }
+    magnitudeScalar(modes, &p[j], &m[j], n - j);
+}
+#endif
+
+static magnitudeFn magnitudeKernel = magnitudeScalar;
+
+//
+// Returns 1 if fn gives the same magnitude as the lookup table for every
+// possible I/Q pair.
+//
+static int magnitudeKernelMatches(Modes *modes, magnitudeFn fn) {
+    uint16_t *in, *out;
+    uint32_t  j;
+    int       ok = 1;
+
+    in  = (uint16_t *) malloc(sizeof(uint16_t) * 65536);
+    out = (uint16_t *) malloc(sizeof(uint16_t) * 65536);
+    if (!in || !out) {
+        free(in); free(out);
+        return 0;
+    }
+    for (j = 0; j < 65536; j++) {in[j] = (uint16_t) j;}
+
+    fn(modes, in, out, 65536);
+    for (j = 0; j < 65536; j++) {
+        if (out[j] != modes->maglut[j]) {ok = 0; break;}
+    }
+    free(in); free(out);
+    return ok;
+}
+
+//
+// The kernels this CPU can run, scalar first and best last. Returns how
+// many were written to kernels and names.
+//
+int magnitudeKernels(magnitudeFn *kernels, const char **names, int max) {
+    int n = 0;
+
+#define MODES_ADD_KERNEL(fn, name) if (n < max) {kernels[n] = fn; names[n] = name; n++;}
+    MODES_ADD_KERNEL(magnitudeScalar, "scalar");
+#ifdef MODES_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) {MODES_ADD_KERNEL(magnitudeSSE41, "sse4.1");}
+    if (__builtin_cpu_supports("avx2"))   {MODES_ADD_KERNEL(magnitudeAVX2,  "avx2");}
+#endif
+#ifdef MODES_HAVE_NEON_KERNELS
+    MODES_ADD_KERNEL(magnitudeNEON, "neon");
+#endif
+#undef MODES_ADD_KERNEL
+
+    return n;
+}
+
+//
+// Pick the magnitude kernel from CPU features alone: the best vector
+// version the CPU supports, as long as it reproduces the lookup table
+// exactly. Timing it here against the table isn't reliable, as the table
+// is tiny and hot in a microbenchmark and not with a real signal.
+//
+static void selectMagnitudeKernel(Modes *modes) {
+    magnitudeFn kernels[4];
+    const char *names[4];
+    int         n = magnitudeKernels(kernels, names, 4);
+
+    magnitudeKernel = kernels[n - 1];
+    if (!magnitudeKernelMatches(modes, magnitudeKernel)) {
+        fprintf(stderr, "%s magnitude kernel does not match the lookup table, using scalar.\n", names[n - 1]);
+        magnitudeKernel = magnitudeScalar;
+        n = 1;
+    }
+    if (!modes->quiet) {
+        fprintf(stderr, "Using %s magnitude kernel.\n", names[n - 1]);
+    }
+}
+//
+//=========================================================================
+//
+// Turn a block of MODES_ASYNC_BUF_SAMPLES I/Q samples into magnitudes.
+//
+// The tail of the previous block (one preamble plus one long message) is
+// kept at the start of the magnitude vector so that messages straddling
+// two blocks are still found.
+//
+void computeMagnitudeVector(Modes *modes, uint16_t *p) {
+    uint16_t *m = &modes->magnitude[MODES_PREAMBLE_SAMPLES+MODES_LONG_MSG_SAMPLES];
+
+    memcpy(modes->magnitude, &modes->magnitude[MODES_ASYNC_BUF_SAMPLES], MODES_PREAMBLE_SIZE+MODES_LONG_MSG_SIZE);
+
+    magnitudeKernel(modes, p, m, MODES_ASYNC_BUF_SAMPLES);
+}
+//
+//=========================================================================
+//
+// The Mode S preamble is made of impulses of 0.5 microseconds at 0, 1.0,
+// 3.5 and 4.5 usec. At 2 Msps that is a high sample at 0, 2, 7 and 9 with
+// low samples in between.
+//
+// Almost every sample position fails the first relational test, so run it
+// without branches over a whole run of positions at a time (which the
+// compiler can vectorize), and only apply the full per-position checks to
+// the few candidates it lets through.
+//
+#define MODES_PREAMBLE_RUN 256
+
+static int findPreambleCandidates(uint16_t *m, uint32_t start, uint32_t end, uint16_t *cand) {
+    uint8_t  hit[MODES_PREAMBLE_RUN];
+    uint32_t j, n = end - start;
+    int      count = 0;
+
+    for (j = 0; j < n; j++) {
+        uint16_t *p = &m[start + j];
+        hit[j] = (p[0] > p[1]) & (p[1] < p[2]) & (p[2] > p[3]) & (p[3] < p[0]) &
+                 (p[4] < p[0]) & (p[5] < p[0]) & (p[6] < p[0]) & (p[7] > p[8]) &
+                 (p[8] < p[9]) & (p[9] > p[6]);
+    }
+
+    for (j = 0; j < n; j++) {
+        if (hit[j]) {cand[count++] = (uint16_t) j;}
+    }
+    return count;
+}
+//
+//=========================================================================
+//
+// Slice the 112 data bits that follow a preamble into msg[], comparing the
+// two samples of each bit (Pulse Position Modulation). Returns the message
+// length in bits, or 0 if the frame is not worth decoding. *pErrors gets
+// the number of bits we had to guess, *pSig the signal strength.
+//
+static int sliceModesBits(Modes *modes, uint16_t *pPreamble, uint16_t *pPayload, unsigned char *msg, int *pErrors, int *pSig) {
+    uint16_t      *pPtr = pPayload;
+    unsigned char *pMsg = msg;
+    uint8_t        theByte = 0, theErrs = 0;
+    int            errors = 0, errors56 = 0, errorsTy = 0;
+    int            msglen, scanlen, i;
+
+    // We should have 4 'bits' of 0/1 and 1/0 samples in the preamble,
+    // so include these in the signal strength
+    int sigStrength = (pPreamble[0]-pPreamble[1])
+                    + (pPreamble[2]-pPreamble[3])
+                    + (pPreamble[7]-pPreamble[6])
+                    + (pPreamble[9]-pPreamble[8]);
+
+    msglen = scanlen = MODES_LONG_MSG_BITS;
+    for (i = 0; i < scanlen; i++) {
+        uint32_t a = *pPtr++;
+        uint32_t b = *pPtr++;
+
+        if      (a > b)
+            {theByte |= 1; if (i < 56) {sigStrength += (a-b);}}
+        else if (a < b)
+            {if (i < 56) {sigStrength += (b-a);}}
+        else if (i >= MODES_SHORT_MSG_BITS) // (a == b), in the long part of a frame
+            {errors++;}
+        else if (i >= 5)                    // (a == b), in the short part of a frame
+            {scanlen = MODES_LONG_MSG_BITS; errors56 = ++errors;}
+        else if (i)                         // (a == b), in the DF part of a frame
+            {errorsTy = errors56 = ++errors; theErrs |= 1;}
+        else                                // (a == b), in the first bit of the DF
+            {errorsTy = errors56 = ++errors; theErrs |= 1; theByte |= 1;}
+
+        if ((i & 7) == 7) {
+            *pMsg++ = theByte;
+        } else if (i == 4) {
+            msglen = modesMessageLenByType(theByte);
+            if (errors == 0) {scanlen = msglen;}
+        }
+
+        theByte = theByte << 1;
+        if (i < 7) {theErrs = theErrs << 1;}
+
+        // If we've exceeded the permissible number of encoding errors, abandon ship now
+        if (errors > MODES_MSG_ENCODER_ERRS) {
+            if (i < MODES_SHORT_MSG_BITS) {
+                msglen = 0;
+            } else if ((errorsTy == 1) && (theErrs == 0x80)) {
+                // We guessed a '1' for the DF length bit; the frame looks short,
+                // so invert the bit and carry on with the first 56 bits
+                msglen  = MODES_SHORT_MSG_BITS;
+                msg[0] ^= theErrs; errorsTy = 0;
+                errors  = errors56;
+                modes->stat_DF_Len_Corrected++;
+            } else if (i < MODES_LONG_MSG_BITS) {
+                msglen = MODES_SHORT_MSG_BITS;
+                errors = errors56;
             } else {
-                // x [0 1] y
-                // y overlapped with the "1" bit and is slightly high
-                pPayload[j+2] = clamped_scale(pPayload[j+2], scaleDown);
+                msglen = MODES_LONG_MSG_BITS;
+            }
+            break;
+        }
+    }
+
+    // Ensure msglen is consistent with the DF type
+    i = modesMessageLenByType(msg[0] >> 3);
+    if      (msglen > i) {msglen = i;}
+    else if (msglen < i) {msglen = 0;}
+
+    // If we guessed one of the DF bits, keep the guess only if it gives an
+    // ICAO defined DF, otherwise try the other value.
+    if ((msglen) && (errorsTy == 1) && (theErrs & 0x78)) {
+        uint32_t validDFbits = 0x017F0831; // DF 0,4,5,11,16,17,18,19,20,21,22,24
+        theByte = msg[0];
+        if (0 == (validDFbits & (1 << ((theByte >> 3) & 0x1f)))) {
+            theByte ^= theErrs;
+            if (validDFbits & (1 << ((theByte >> 3) & 0x1f))) {
+                msg[0] = theByte;
+                modes->stat_DF_Type_Corrected++;
+                errors--;
+            }
+        }
+    }
+
+    // We measured signal strength over the first 56 bits plus 4 for the
+    // preamble, so round up and divide by 60.
+    *pSig    = (sigStrength + 29) / 60;
+    *pErrors = errors;
+    return msglen;
+}
+//
+//=========================================================================
+//
+// Detect Mode S messages in the magnitude vector m of mlen samples, decode
+// them and pass them on with useModesMessage().
+//
+void detectModeS(Modes *modes, uint16_t *m, uint32_t mlen) {
+    struct modesMessage mm;
+    unsigned char msg[MODES_LONG_MSG_BYTES];
+    uint16_t aux[MODES_PREAMBLE_SAMPLES+MODES_LONG_MSG_SAMPLES+1];
+    uint16_t cand[MODES_PREAMBLE_RUN];
+    uint32_t start, next = 0;
+
+    memset(&mm, 0, sizeof(mm));
+
+    // Mode A/C replies have no preamble to prefilter on, so they get their
+    // own pass over the block; detectModeA() rejects most positions on
+    // its first test.
+    if (modes->mode_ac) {
+        for (start = 0; start < mlen; start++) {
+            int ModeA = detectModeA(&m[start], &mm);
+
+            if (ModeA) {
+                mm.timestampMsg = modes->timestampBlk + ((start+1)*6);
+                decodeModeAMessage(&mm, ModeA);
+                useModesMessage(modes, &mm);
+                modes->stat_ModeAC++;
+                start += MODEAC_MSG_SAMPLES;
+            }
+        }
+        memset(&mm, 0, sizeof(mm));
+    }
+
+    for (start = 0; start < mlen; start += MODES_PREAMBLE_RUN) {
+        uint32_t end = (start + MODES_PREAMBLE_RUN < mlen) ? start + MODES_PREAMBLE_RUN : mlen;
+        int      ncand = findPreambleCandidates(m, start, end, cand);
+        int      c;
+
+        for (c = 0; c < ncand; c++) {
+            uint32_t  j = start + cand[c];
+            uint16_t *pPreamble = &m[j];
+            uint16_t *pPayload  = &m[j+MODES_PREAMBLE_SAMPLES];
+            int       use_correction = 0;
+            int       high;
+
+            if (j < next) {continue;} // Inside a message we already decoded
+
+            // The samples between the two spikes must be lower than the
+            // average of the high spikes level, and so must the gap between
+            // the preamble and the data. Samples right next to the spikes
+            // are not tested as out of phase signals leak into them.
+            high = (pPreamble[0] + pPreamble[2] + pPreamble[7] + pPreamble[9]) / 6;
+            if ( (pPreamble[ 4] >= high) || (pPreamble[ 5] >= high)
+              || (pPreamble[11] >= high) || (pPreamble[12] >= high)
+              || (pPreamble[13] >= high) || (pPreamble[14] >= high) ) {
+                continue;
+            }
+            modes->stat_valid_preamble++;
+
+            while (1) {
+                int msglen, errors, sigStrength;
+
+                mm.bFlags = mm.crcok = mm.correctedbits = 0;
+
+                msglen = sliceModesBits(modes, pPreamble, pPayload, msg, &errors, &sigStrength);
+
+                if ( (msglen)
+                  && (sigStrength >  MODES_MSG_SQUELCH_LEVEL)
+                  && (errors      <= MODES_MSG_ENCODER_ERRS) ) {
+
+                    mm.timestampMsg    = modes->timestampBlk + (j*6);
+                    sigStrength        = (sigStrength + 0x7F) >> 8;
+                    mm.signalLevel     = ((sigStrength < 255) ? sigStrength : 255);
+                    mm.phase_corrected = use_correction;
+
+                    decodeModesMessage(modes, &mm, msg);
+
+                    if (mm.crcok) {
+                        if (use_correction) {modes->stat_ph_goodcrc++;} else {modes->stat_goodcrc++;}
+                        next = j + (MODES_PREAMBLE_US+msglen)*2;
+                    } else {
+                        if (use_correction) {modes->stat_ph_badcrc++;}  else {modes->stat_badcrc++;}
+                    }
+                    if (mm.correctedbits) {
+                        if (use_correction) {modes->stat_ph_fixed++;}   else {modes->stat_fixed++;}
+                    }
+
+                    useModesMessage(modes, &mm);
+                }
+
+                // Retry once with phase correction if enabled, necessary and possible
+                if ( (modes->phase_enhance) && (!use_correction) && (!mm.crcok) && (!mm.correctedbits)
+                  && (j) && (detectOutOfPhase(pPreamble)) ) {
+                    memcpy(aux, &pPreamble[-1], sizeof(aux));
+                    applyPhaseCorrection(&aux[1]);
+                    modes->stat_out_of_phase++;
+                    pPayload       = &aux[1+MODES_PREAMBLE_SAMPLES];
+                    use_correction = 1;
+                    continue;
+                }
+                break;
             }
         }
     }
@@ -882,7 +1547,7 @@ void applyPhaseCorrection(uint16_t *pPayload) {
 //
 //=========================================================================
 //
-// When a new message is available, because it was decoded from the RTL device, 
+// When a new message is available, because it was decoded from the RTL device,
 // file, or received in the TCP input port, or any other way we can receive a 
 // decoded message, we call this function in order to use the message.
 //
@@ -1020,7 +1685,7 @@ int decodeCPR(Modes *modes, struct aircraft *a, int fflag, int surface) {
     double rlat0 = AirDlat0 * (cprModFunction(j,60) + lat0 / 131072);
     double rlat1 = AirDlat1 * (cprModFunction(j,59) + lat1 / 131072);
 
-    time_t now = time(NULL);
+    time_t now = modes->clock_now;
     double surface_rlat = MODES_USER_LATITUDE_DFLT;
     double surface_rlon = MODES_USER_LONGITUDE_DFLT;
 
@@ -1073,7 +1738,6 @@ int decodeCPR(Modes *modes, struct aircraft *a, int fflag, int surface) {
     }
 
     a->seenLatLon      = a->seen;
-    a->timestampLatLon = a->timestamp;
     a->bFlags         |= (MODES_ACFLAGS_LATLON_VALID | MODES_ACFLAGS_LATLON_REL_OK);
 
     return 0;
@@ -1155,7 +1819,6 @@ int decodeCPRrelative(Modes *modes, struct aircraft *a, int fflag, int surface)
     a->lon = rlon;
 
     a->seenLatLon      = a->seen;
-    a->timestampLatLon = a->timestamp;
     a->bFlags         |= (MODES_ACFLAGS_LATLON_VALID | MODES_ACFLAGS_LATLON_REL_OK);
     return (0);
 }
@@ -95,7 +95,7 @@ void modesCloseClient(Modes *modes, struct client *c) {
     }
 
     if (modes->debug & MODES_DEBUG_NET)
-        printf("Closing client %d\n", c->fd);
+        fprintf(stderr, "Closing client %d\n", c->fd);
 
     c->fd = -1;
 }
@@ -125,7 +125,7 @@ int decodeBinMessage(Modes *modes, struct client *c, char *p) {
     ch = *p++; /// Get the message type
     if (0x1A == ch) {p++;} 
 
-    if       ((ch == '1') && (modes->mode_ac)) { // skip ModeA/C unless user enables --modes-ac
+    if       ((ch == '1') && (modes->mode_ac)) { // skip ModeA/C if the user disables it with --no-modeac
         msgLen = MODEAC_MSG_BYTES;
     } else if (ch == '2') {
         msgLen = MODES_SHORT_MSG_BYTES;
@@ -152,11 +152,12 @@ int decodeBinMessage(Modes *modes, struct client *c, char *p) {
             if (0x1A == ch) {p++;}
         }
 
-        // if (msgLen == MODEAC_MSG_BYTES) { // ModeA or ModeC
-        //     decodeModeAMessage(modes, &mm, ((msg[0] << 8) | msg[1]));
-        // } else {
+        if (msgLen == MODEAC_MSG_BYTES) { // ModeA or ModeC
+            decodeModeAMessage(&mm, ((msg[0] << 8) | msg[1]));
+            modes->stat_ModeAC++;
+        } else {
             decodeModesMessage(modes, &mm, msg);
-        //}
+        }
 
         useModesMessage(modes, &mm);
     }
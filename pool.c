@@ -0,0 +1,124 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+
+#define poolLink(p, h) ((int *) ((unsigned char *) poolSlab(p, h) + (p)->linkOffset + poolSlot(h) * (p)->linkStride))
+
+void poolInit(struct pool *p, const char *name, size_t slabSize, size_t linkOffset, size_t linkStride) {
+    memset(p, 0, sizeof(*p));
+
+    p->name       = name;
+    p->slabSize   = slabSize;
+    p->linkOffset = linkOffset;
+    p->linkStride = linkStride;
+    p->freeHandle = POOL_NONE;
+}
+//
+//=========================================================================
+//
+// Add a slab to the pool and put all its records on the free list. Owners
+// that keep per handle tables of their own can call this themselves when
+// free is 0, so those tables grow along with the pool.
+//
+int poolGrow(struct pool *p) {
+    void **slabs = (void **) realloc(p->slabs, (p->slabCount + 1) * sizeof(*slabs));
+    void  *slab;
+    int    j;
+
+    if (!slabs) {
+        return 0;
+    }
+    p->slabs = slabs;
+
+    if (!(slab = malloc(p->slabSize))) {
+        return 0;
+    }
+    p->slabs[p->slabCount++] = slab;
+
+    // Hand out the lowest handles first
+    for (j = POOL_SLAB - 1; j >= 0; j--) {
+        int handle = (p->slabCount - 1) * POOL_SLAB + j;
+
+        *poolLink(p, handle) = p->freeHandle;
+        p->freeHandle        = handle;
+    }
+    p->free += POOL_SLAB;
+    return 1;
+}
+//
+//=========================================================================
+//
+// Return the handle of an uninitialised record, or POOL_NONE if the pool
+// can't grow
+//
+int poolAlloc(struct pool *p) {
+    int handle;
+
+    if ((p->freeHandle == POOL_NONE) && !poolGrow(p)) {
+        return POOL_NONE;
+    }
+
+    handle        = p->freeHandle;
+    p->freeHandle = *poolLink(p, handle);
+    p->free--;
+
+    if (++p->live > p->highWater) {
+        p->highWater = p->live;
+    }
+    return handle;
+}
+
+void poolFree(struct pool *p, int handle) {
+    *poolLink(p, handle) = p->freeHandle;
+    p->freeHandle        = handle;
+    p->live--;
+    p->free++;
+}
+//
+//=========================================================================
+//
+// Give every slab back to the system. Any record still live is invalid
+// afterwards.
+//
+void poolDestroy(struct pool *p) {
+    unsigned int j;
+
+    for (j = 0; j < p->slabCount; j++) {free(p->slabs[j]);}
+    free(p->slabs);
+
+    p->slabs      = NULL;
+    p->freeHandle = POOL_NONE;
+    p->slabCount  = p->live = p->free = 0;
+}
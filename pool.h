@@ -0,0 +1,83 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Fixed size record pool. Records are carved out of slabs of POOL_SLAB that
+// are never given back to the system or moved, so once a pool has grown to
+// the working set, allocating and freeing is just a free list push or pop
+// and long running sessions don't fragment the heap.
+//
+// Records are named by handle, slab << POOL_SLAB_BITS | slot, and the slab
+// layout is up to the owner: one array per field group if it likes. Free
+// records are linked through an int in each of them, linkOffset bytes into
+// the slab plus linkStride per slot.
+//
+#define POOL_SLAB_BITS  6
+#define POOL_SLAB       (1 << POOL_SLAB_BITS)
+#define POOL_NONE       (-1)
+
+struct pool {
+    const char      *name;       // For statistics
+    size_t           slabSize;   // Bytes per slab, for POOL_SLAB records
+    size_t           linkOffset; // Where slot 0's free list link sits in a slab
+    size_t           linkStride; // and how far apart the links are
+    void           **slabs;
+    int              freeHandle; // Free records, POOL_NONE if there are none
+
+    unsigned int     slabCount;
+    unsigned int     live;       // Records handed out
+    unsigned int     free;       // Records on the free list
+    unsigned int     highWater;  // Most records ever live at once
+};
+
+void  poolInit   (struct pool *p, const char *name, size_t slabSize, size_t linkOffset, size_t linkStride);
+int   poolGrow   (struct pool *p);
+int   poolAlloc  (struct pool *p);
+void  poolFree   (struct pool *p, int handle);
+void  poolDestroy(struct pool *p);
+
+#define poolSlab(p, h)   ((p)->slabs[(h) >> POOL_SLAB_BITS])
+#define poolSlot(h)      ((h) & (POOL_SLAB - 1))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __POOL_H
@@ -0,0 +1,234 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+//
+// Demodulator kernels against their scalar references: every magnitude
+// kernel the CPU can run against the lookup table, and the branch-free
+// applyPhaseCorrection() against the original branching version, on fixed
+// and pseudo-random input. Exits non-zero on the first mismatch.
+//
+// make test
+//
+
+#include "dump1090.h"
+
+Modes modes;
+
+// mode_s.c hands decoded messages on to interactive.c; nothing gets that
+// far here
+struct aircraft *interactiveReceiveData(Modes *modes, struct modesMessage *mm) {
+    (void) modes; (void) mm;
+    return NULL;
+}
+
+static uint32_t rngState = 12345;
+
+// xorshift32, so every run sees the same samples
+static uint32_t rng(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint16_t referenceClampedScale(uint16_t v, uint16_t scale) {
+    uint32_t scaled = (uint32_t)v * scale / 16384;
+    if (scaled > 65535) return 65535;
+    return (uint16_t) scaled;
+}
+
+//
+// applyPhaseCorrection() as it was before the bit decisions went
+// branch-free
+//
+static void referencePhaseCorrection(uint16_t *pPayload) {
+    int j;
+
+    uint32_t onTime = (pPayload[0] + pPayload[2] + pPayload[7] + pPayload[9]);
+    uint32_t early = (pPayload[-1] + pPayload[6]) << 1;
+    uint32_t late = (pPayload[3] + pPayload[10]) << 1;
+
+    if (early > late) {
+        uint16_t scaleUp = 16384 + 16384 * early / (early + onTime);
+        uint16_t scaleDown = 16384 - 16384 * early / (early + onTime);
+
+        pPayload[MODES_PREAMBLE_SAMPLES + MODES_LONG_MSG_SAMPLES - 1] =
+            referenceClampedScale(pPayload[MODES_PREAMBLE_SAMPLES + MODES_LONG_MSG_SAMPLES - 1],  scaleUp);
+        for (j = MODES_PREAMBLE_SAMPLES + MODES_LONG_MSG_SAMPLES - 2; j > MODES_PREAMBLE_SAMPLES; j -= 2) {
+            if (pPayload[j] > pPayload[j+1]) {
+                pPayload[j-1] = referenceClampedScale(pPayload[j-1], scaleDown);
+            } else {
+                pPayload[j-1] = referenceClampedScale(pPayload[j-1], scaleUp);
+            }
+        }
+    } else {
+        uint16_t scaleUp = 16384 + 16384 * late / (late + onTime);
+        uint16_t scaleDown = 16384 - 16384 * late / (late + onTime);
+
+        pPayload[MODES_PREAMBLE_SAMPLES] = referenceClampedScale(pPayload[MODES_PREAMBLE_SAMPLES], scaleUp);
+        for (j = MODES_PREAMBLE_SAMPLES; j < MODES_PREAMBLE_SAMPLES + MODES_LONG_MSG_SAMPLES - 2; j += 2) {
+            if (pPayload[j] > pPayload[j+1]) {
+                pPayload[j+2] = referenceClampedScale(pPayload[j+2], scaleUp);
+            } else {
+                pPayload[j+2] = referenceClampedScale(pPayload[j+2], scaleDown);
+            }
+        }
+    }
+}
+
+//
+// The table against the expression it was built from, then each kernel
+// against the table over every I/Q pair and over random buffers of every
+// length and alignment the vector loops split differently
+//
+static int testMagnitude(void) {
+    magnitudeFn kernels[4];
+    const char *names[4];
+    int         n = magnitudeKernels(kernels, names, 4);
+    uint16_t   *in  = (uint16_t *) malloc(sizeof(uint16_t) * (65536 + 64));
+    uint16_t   *out = (uint16_t *) malloc(sizeof(uint16_t) * (65536 + 64));
+    uint32_t    j;
+    int         k, len, offset;
+
+    for (j = 0; j < 65536; j++) {
+        int i = j >> 8, q = j & 255;
+        int mag_i = (i * 2) - 255, mag_q = (q * 2) - 255;
+        int mag = (int) round((sqrt((mag_i*mag_i)+(mag_q*mag_q)) * 258.433254) - 365.4798);
+
+        if (modes.maglut[j] != ((mag < 65535) ? mag : 65535)) {
+            printf("FAIL maglut[%u] = %u, expected %d\n", j, modes.maglut[j], mag);
+            return 0;
+        }
+    }
+
+    for (k = 0; k < n; k++) {
+        for (j = 0; j < 65536; j++) {in[j] = (uint16_t) j;}
+        kernels[k](&modes, in, out, 65536);
+        for (j = 0; j < 65536; j++) {
+            if (out[j] != modes.maglut[j]) {
+                printf("FAIL %s kernel, I/Q 0x%04x: %u, table %u\n", names[k], j, out[j], modes.maglut[j]);
+                return 0;
+            }
+        }
+
+        for (len = 0; len <= 40; len++) {
+            for (offset = 0; offset < 8; offset++) {
+                for (j = 0; j < 64 + 65536 / 8; j++) {
+                    in[j] = (uint16_t) rng();
+                    out[j] = 0xdead;
+                }
+                kernels[k](&modes, in + offset, out + offset, len);
+                for (j = 0; j < 64 + 65536 / 8; j++) {
+                    int inside = j >= (uint32_t) offset && j < (uint32_t) (offset + len);
+                    uint16_t expected = inside ? modes.maglut[in[j]] : 0xdead;
+
+                    if (out[j] != expected) {
+                        printf("FAIL %s kernel, length %d offset %d at %u: %u, expected %u\n",
+                               names[k], len, offset, j, out[j], expected);
+                        return 0;
+                    }
+                }
+            }
+        }
+        printf("ok   %s magnitude kernel\n", names[k]);
+    }
+
+    free(in);
+    free(out);
+    return 1;
+}
+
+#define PAYLOAD_SAMPLES (1 + MODES_PREAMBLE_SAMPLES + MODES_LONG_MSG_SAMPLES)
+
+static int comparePhaseCorrection(const uint16_t *payload, const char *what) {
+    uint16_t a[PAYLOAD_SAMPLES], b[PAYLOAD_SAMPLES];
+    int      j;
+
+    memcpy(a, payload, sizeof(a));
+    memcpy(b, payload, sizeof(b));
+    applyPhaseCorrection(a + 1);
+    referencePhaseCorrection(b + 1);
+
+    for (j = 0; j < PAYLOAD_SAMPLES; j++) {
+        if (a[j] != b[j]) {
+            printf("FAIL applyPhaseCorrection, %s, sample %d: %u, expected %u\n", what, j - 1, a[j], b[j]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int testPhaseCorrection(void) {
+    uint16_t payload[PAYLOAD_SAMPLES];
+    int      i, j;
+
+    // a clean preamble with its energy early, then late, then balanced, and
+    // with the data at full scale so the clamp is hit
+    static const int preamble[] = {1, 0, 1, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0};
+    for (i = 0; i < 4; i++) {
+        payload[0] = (i == 0) ? 9000 : 100;
+        for (j = 0; j < MODES_PREAMBLE_SAMPLES; j++) {
+            payload[1 + j] = preamble[j] ? 40000 : 100;
+        }
+        payload[1 + 6]  = (i == 0) ? 9000 : 100;
+        payload[1 + 3]  = (i == 1) ? 9000 : 100;
+        payload[1 + 10] = (i == 1) ? 9000 : 100;
+        for (j = 1 + MODES_PREAMBLE_SAMPLES; j < PAYLOAD_SAMPLES; j++) {
+            payload[j] = (i == 3) ? 65535 : (((j >> 1) & 1) ? 50000 : 2000);
+        }
+        if (!comparePhaseCorrection(payload, "fixed payload")) {return 0;}
+    }
+
+    for (i = 0; i < 200000; i++) {
+        // mostly small noise with strong pulses, some anywhere in range;
+        // at least one non-zero preamble sample, as both divide by it
+        int strong = rng() & 1;
+        for (j = 0; j < PAYLOAD_SAMPLES; j++) {
+            payload[j] = strong ? (uint16_t) rng() : (uint16_t) ((rng() & 3) ? rng() & 0x3ff : 30000 + (rng() & 0x7fff));
+        }
+        payload[1] |= 1;
+        if (!comparePhaseCorrection(payload, "random payload")) {return 0;}
+    }
+
+    printf("ok   applyPhaseCorrection\n");
+    return 1;
+}
+
+int main(void) {
+    memset(&modes, 0, sizeof(modes));
+    modes.quiet = 1;
+    modesInitDemod(&modes);
+
+    if (!testMagnitude() || !testPhaseCorrection()) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <string.h>
+
+#include "timerwheel.h"
+
+void timerWheelInit(struct timerWheel *w, time_t now) {
+    memset(w, 0, sizeof(*w));
+    w->now = now;
+}
+
+void timerInit(struct timerNode *n, timerFn expire) {
+    n->next    = NULL;
+    n->pprev   = NULL;
+    n->expires = 0;
+    n->expire  = expire;
+}
+//
+//=========================================================================
+//
+// Put n in the slot for n->expires, relative to the wheel's current time
+//
+static void timerLink(struct timerWheel *w, struct timerNode *n) {
+    time_t             delta = n->expires - w->now;
+    struct timerNode **slot;
+
+    if (delta < TIMERWHEEL_SLOTS) {
+        slot = &w->slots[0][n->expires & TIMERWHEEL_MASK];
+    } else if (delta < ((time_t) TIMERWHEEL_SLOTS << TIMERWHEEL_BITS)) {
+        slot = &w->slots[1][(n->expires >> TIMERWHEEL_BITS) & TIMERWHEEL_MASK];
+    } else {
+        // Too far out, park it in the furthest level 1 slot and let it
+        // cascade back in from there
+        slot = &w->slots[1][((w->now >> TIMERWHEEL_BITS) + TIMERWHEEL_MASK) & TIMERWHEEL_MASK];
+    }
+
+    if ((n->next = *slot)) {
+        (*slot)->pprev = &n->next;
+    }
+    n->pprev = slot;
+    *slot    = n;
+}
+
+static void timerUnlink(struct timerNode *n) {
+    if ((*n->pprev = n->next)) {
+        n->next->pprev = n->pprev;
+    }
+    n->next  = NULL;
+    n->pprev = NULL;
+}
+//
+//=========================================================================
+//
+// (Re)arm n to fire at second 'expires'. Times that have already passed
+// fire on the next advance.
+//
+void timerAdd(struct timerWheel *w, struct timerNode *n, time_t expires) {
+    if (timerPending(n)) {
+        timerUnlink(n);
+    } else {
+        w->pending++;
+    }
+    n->expires = (expires > w->now) ? expires : w->now + 1;
+    timerLink(w, n);
+}
+
+void timerDel(struct timerWheel *w, struct timerNode *n) {
+    if (timerPending(n)) {
+        timerUnlink(n);
+        w->pending--;
+    }
+}
+//
+//=========================================================================
+//
+// Take every timer off a slot, fire those that are due by 'now' and put the
+// rest back in the slot they belong in now. The slot is detached onto
+// w->running first, so timers re-added or deleted by the callbacks (even
+// ones still on that list) are handled correctly.
+//
+static void timerRunSlot(struct timerWheel *w, struct timerNode **slot, time_t now, void *ctx) {
+    struct timerNode *n;
+
+    w->running = *slot;
+    *slot      = NULL;
+    if (w->running) {
+        w->running->pprev = &w->running;
+    }
+
+    while ((n = w->running)) {
+        timerUnlink(n);
+        if (n->expires <= now) {
+            w->pending--;
+            n->expire(ctx, n);
+        } else {
+            timerLink(w, n);
+        }
+    }
+}
+//
+//=========================================================================
+//
+// Move the wheel on to 'now', firing every timer that expires on the way
+//
+void timerWheelAdvance(struct timerWheel *w, time_t now, void *ctx) {
+    if ((now - w->now) >= ((time_t) TIMERWHEEL_SLOTS << TIMERWHEEL_BITS)) {
+        // We've been away for longer than the wheel spans (clock jump,
+        // suspend): run every slot once rather than stepping through
+        int level, j;
+
+        w->now = now;
+        for (level = 0; level < 2; level++) {
+            for (j = 0; j < TIMERWHEEL_SLOTS; j++) {
+                timerRunSlot(w, &w->slots[level][j], now, ctx);
+            }
+        }
+        return;
+    }
+
+    while (w->now < now) {
+        time_t t = ++w->now;
+
+        // Every 64 seconds bring the next level 1 slot down to level 0
+        if ((t & TIMERWHEEL_MASK) == 0) {
+            timerRunSlot(w, &w->slots[1][(t >> TIMERWHEEL_BITS) & TIMERWHEEL_MASK], t, ctx);
+        }
+        timerRunSlot(w, &w->slots[0][t & TIMERWHEEL_MASK], t, ctx);
+    }
+}
@@ -0,0 +1,82 @@
+// viz1090, a vizualizer for dump1090 ADSB output
+//
+// Copyright (C) 2020, Nathan Matsuda <info@nathanmatsuda.com>
+// Copyright (C) 2014, Malcolm Robb <Support@ATTAvionics.com>
+// Copyright (C) 2012, Salvatore Sanfilippo <antirez at gmail dot com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//  *  Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  *  Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef __TIMERWHEEL_H
+#define __TIMERWHEEL_H
+
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Two level hierarchical timer wheel with one second resolution. Level 0 has
+// a slot per second for the next 64 seconds, level 1 a slot per 64 seconds
+// for the next ~68 minutes; anything further out sits in the last level 1
+// slot until it comes in range. Adding and removing a timer is O(1), and
+// advancing the wheel only touches the timers that expire or cascade.
+//
+#define TIMERWHEEL_BITS   6
+#define TIMERWHEEL_SLOTS  (1 << TIMERWHEEL_BITS)
+#define TIMERWHEEL_MASK   (TIMERWHEEL_SLOTS - 1)
+
+struct timerNode;
+typedef void (*timerFn)(void *ctx, struct timerNode *n);
+
+// Embed one of these in the object to be timed
+struct timerNode {
+    struct timerNode  *next;
+    struct timerNode **pprev;    // NULL when the timer is not pending
+    time_t             expires;  // Second at which expire() is called
+    timerFn            expire;   // Called with the timer already removed
+};
+
+struct timerWheel {
+    time_t             now;      // Last second processed
+    unsigned int       pending;  // Number of timers in the wheel
+    struct timerNode  *slots[2][TIMERWHEEL_SLOTS];
+    struct timerNode  *running;  // The slot being run by timerWheelAdvance()
+};
+
+void timerWheelInit   (struct timerWheel *w, time_t now);
+void timerWheelAdvance(struct timerWheel *w, time_t now, void *ctx);
+void timerInit        (struct timerNode *n, timerFn expire);
+void timerAdd         (struct timerWheel *w, struct timerNode *n, time_t expires);
+void timerDel         (struct timerWheel *w, struct timerNode *n);
+
+#define timerPending(n) ((n)->pprev != NULL)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TIMERWHEEL_H
@@ -32,7 +32,9 @@
 #include "AppData.h"
 #include "View.h"
 #include "Input.h"
+#include "Profiler.h"
 #include <cstring> 
+#include <algorithm>
 #include <windows.h>
 
 int go = 1;
@@ -51,6 +53,13 @@ void showHelp(void) {
 "-----------------------------------------------------------------------------\n"
   "--server <IPv4/hosname>          TCP Beast output listen IPv4 (default: 127.0.0.1)\n"
   "--port <port>                    TCP Beast output listen port (default: 30005)\n"
+  "--ifile <filename>               Demodulate 8 bit I/Q samples from file (use '-' for stdin)\n"
+  "--no-modeac                      Ignore Mode A/C replies\n"
+  "--phase-enhance                  Retry failed Mode S frames with phase correction\n"
+  "--demod-bench                    Demodulate the whole --ifile as fast as possible and report samples/s\n"
+  "--dflog                          Keep the most recent DF's of each aircraft in a fixed size log, show the selected one's\n"
+  "--bench-labels <n>               Time label placement for up to n random aircraft and exit\n"
+  "--bench-raster                   Time map rasterization at --lat/--lon and exit\n"
   "--lat <latitude>                 Latitide in degrees\n"
   "--lon <longitude>                Longitude in degrees\n"
   "--metric                         Use metric units\n"
@@ -59,10 +68,24 @@ void showHelp(void) {
   "--screensize <width> <height>    Set frame buffer resolution (default: screen resolution)\n"
   "--screenindex <i>                Set the index of the display to use (default: 0)\n"
   "--fullscreen                     Start fullscreen\n"
+  "--headless                       Render offscreen without a display, exit when an --ifile replay ends\n"
+  "--snapshot <file>                PNG snapshot file, '-' for stdout, %%d is replaced by a counter\n"
+  "                                 (default: viz1090-%%d.png, 'p' writes one on demand)\n"
+  "--snapshot-interval <ms>         Write a snapshot every ms milliseconds\n"
+  "--profile                        Show the frame profiler overlay ('f' toggles it)\n"
+  "--trace <file>                   Write the last frames' profiler scopes as Chrome trace JSON on exit\n"
     );
 }
 
 
+static const char *traceFile = NULL;
+
+static void writeTraceAtExit(void) {
+    if (!profiler.writeTrace(traceFile)) {
+        fprintf(stderr, "Couldn't write trace file %s\n", traceFile);
+    }
+}
+
 //
 //=========================================================================
 //
@@ -76,6 +99,8 @@ int WINAPI WinMain(HINSTANCE hInstance,
 
 ////////        int main(int argc, char **argv) {
     int j;
+    int benchLabels = 0;
+    int benchRaster = 0;
 
     AppData appData;
     View view(&appData);
@@ -83,19 +108,45 @@ int WINAPI WinMain(HINSTANCE hInstance,
 
     signal(SIGINT, SIG_DFL);  // reset signal handler - bit extra safety
 
-    appData.initialize();
+    // Defaults for the Windows build, overridden by the command line below
+    appData.modes.net_input_beast_port = 4000;
+    std::strcpy(appData.server, "127.0.0.1");
+    appData.modes.fUserLat = 0.0;
+    view.centerLat = appData.modes.fUserLat;
+    appData.modes.fUserLon = 0.0;
+    view.centerLon = appData.modes.fUserLon;
+    view.metric = 1;
+    view.fullscreen = 1;
+    view.screen_index = 1;
+    view.screen_uiscale = 1;
+    view.screen_width = 800;
+    view.screen_height = 800;
 
     // Parse the command line options
-    
-    /******************************************
-    
+    int argc = __argc;
+    char **argv = __argv;
+
     for (j = 1; j < argc; j++) {
         int more = ((j + 1) < argc); // There are more arguments
 
         if        (!strcmp(argv[j],"--port") && more) {
             appData.modes.net_input_beast_port = atoi(argv[++j]);
         } else if (!strcmp(argv[j],"--server") && more) {
-            std::strcpy(appData.server, argv[++j]);            
+            std::strncpy(appData.server, argv[++j], sizeof(appData.server) - 1);
+        } else if (!strcmp(argv[j],"--ifile") && more) {
+            appData.modes.filename = strdup(argv[++j]);
+        } else if (!strcmp(argv[j],"--no-modeac")) {
+            appData.modes.mode_ac = 0;
+        } else if (!strcmp(argv[j],"--phase-enhance")) {
+            appData.modes.phase_enhance = 1;
+        } else if (!strcmp(argv[j],"--demod-bench")) {
+            appData.benchDemod = 1;
+        } else if (!strcmp(argv[j],"--dflog")) {
+            appData.modes.bEnableDFLogging = 1;
+        } else if (!strcmp(argv[j],"--bench-labels") && more) {
+            benchLabels = atoi(argv[++j]);
+        } else if (!strcmp(argv[j],"--bench-raster")) {
+            benchRaster = 1;
         } else if (!strcmp(argv[j],"--lat") && more) {
             appData.modes.fUserLat = atof(argv[++j]);
             view.centerLat = appData.modes.fUserLat;
@@ -105,14 +156,24 @@ int WINAPI WinMain(HINSTANCE hInstance,
         } else if (!strcmp(argv[j],"--metric")) {
             view.metric = 1;
         } else if (!strcmp(argv[j],"--fullscreen")) {
-            view.fullscreen = 1;         
-        } else if (!strcmp(argv[j],"--screenindex")) {
-            view.screen_index = atoi(argv[++j]);         
+            view.fullscreen = 1;
+        } else if (!strcmp(argv[j],"--screenindex") && more) {
+            view.screen_index = atoi(argv[++j]);
         } else if (!strcmp(argv[j],"--uiscale") && more) {
-            view.screen_uiscale = atoi(argv[++j]);   
-         } else if (!strcmp(argv[j],"--screensize") && more) {
-            view.screen_width = atoi(argv[++j]);        
-            view.screen_height = atoi(argv[++j]);        
+            view.screen_uiscale = atoi(argv[++j]);
+        } else if (!strcmp(argv[j],"--screensize") && (j + 2) < argc) {
+            view.screen_width = atoi(argv[++j]);
+            view.screen_height = atoi(argv[++j]);
+        } else if (!strcmp(argv[j],"--headless")) {
+            view.headless = 1;
+        } else if (!strcmp(argv[j],"--snapshot") && more) {
+            view.snapshotPath = argv[++j];
+        } else if (!strcmp(argv[j],"--snapshot-interval") && more) {
+            view.snapshotInterval = atoi(argv[++j]);
+        } else if (!strcmp(argv[j],"--profile")) {
+            view.showProfile = true;
+        } else if (!strcmp(argv[j],"--trace") && more) {
+            traceFile = argv[++j];
         } else if (!strcmp(argv[j],"--help")) {
             showHelp();
             exit(0);
@@ -122,44 +183,39 @@ int WINAPI WinMain(HINSTANCE hInstance,
             exit(1);
         }
     }
-    
-    **********************************************/
-    
-    
-    
-    
-               appData.modes.net_input_beast_port = 4000;
-    
-            std::strcpy(appData.server, "127.0.0.1");            
-      
-            appData.modes.fUserLat = atof("0.0");
-            view.centerLat = appData.modes.fUserLat;
-       
-            appData.modes.fUserLon = atof("0.0");
-            view.centerLon = appData.modes.fUserLon;
-     
-            view.metric = 1;
-    
-            view.fullscreen = 1;         
-     
-            view.screen_index = atoi("1");         
-     
-            view.screen_uiscale = atoi("1");   
-       
-            view.screen_width = atoi("800");        
-            view.screen_height = atoi("800"); 
-    
-    
-    
-    
-    
-    
-    
-    
-    
+
+    // The trace goes out from an atexit handler so that the exit()s on
+    // start up errors write it too
+    if (traceFile) {
+        atexit(writeTraceAtExit);
+    }
+
+    if (benchLabels) {
+        view.labelBench(benchLabels);
+        return (0);
+    }
+
+    if (benchRaster) {
+        view.rasterBench();
+        return (0);
+    }
+
+    if (appData.benchDemod && !appData.modes.filename) {
+        fprintf(stderr, "--demod-bench needs an --ifile recording.\n");
+        exit(1);
+    }
+
+    appData.initialize();
+
     int go;
 
     appData.connect();
+
+    if (appData.benchDemod) {
+        appData.demodBench();
+        appData.disconnect();
+        return (0);
+    }
   
     
     view.SDL_init();
@@ -167,13 +223,41 @@ int WINAPI WinMain(HINSTANCE hInstance,
             
     go = 1;
           
+    input.startIngestWakeup();
+
+    // Only draw when there's input, new data or something still animating,
+    // otherwise sleep until one of those can happen
     while (go == 1)
     {
         input.getInput();
-        appData.update();
-        view.draw();
+
+        // Quit by returning from here, so ~Input and ~View stop their
+        // threads before static destructors and atexit handlers run
+        if (input.quit) {
+            break;
+        }
+
+        if (appData.update()) {
+            view.dirty = 1;
+        }
+        input.ingestHandled();
+
+        if (view.needsDraw()) {
+            view.draw();
+        } else if (view.headless && appData.modes.filename && appData.modes.exit && !view.rasterPending()) {
+            // Replay finished and the scene has settled: final snapshot and stop
+            view.requestSnapshot();
+            view.draw();
+            go = 0;
+        } else {
+            input.waitForInput(std::min(view.idleTimeout(), appData.ingestTimeout()));
+        }
     }
     
+    if (view.headless) {
+        view.printDrawStats();
+    }
+
     appData.disconnect();
 
     return (0);